@@ -34,6 +34,16 @@ static std::string toHex(const std::vector<uint8_t>& v){
     return os.str();
 }
 
+static const char* levelToStr(ExchangeLevel l){
+    switch (l){
+    case ExchangeLevel::Character:    return "символьный";
+    case ExchangeLevel::Tpdu:         return "TPDU";
+    case ExchangeLevel::ShortApdu:    return "короткий APDU";
+    case ExchangeLevel::ExtendedApdu: return "расширенный APDU";
+    }
+    return "?";
+}
+
 static const char* presenceToStr(CardPresence p){
     switch (p){
     case CardPresence::NotPresent:      return "нет карты";
@@ -53,12 +63,15 @@ int main(int argc, char *argv[])
     p.setApplicationDescription(
         "Консольная утилита работы с ACR38 через универсальную библиотеку.\n"
         "Команды:\n"
+        "  list                     — подключённые ридеры (путь на шине, серийный номер)\n"
         "  info                     — сведения о ридере и библиотеке\n"
         "  status                   — состояние карты\n"
         "  poweron                  — подать питание и вывести ATR\n"
         "  poweroff                 — снять питание\n"
         "  xfr <APDUhex>            — передать APDU (напр. \"00 A4 04 00 00\")\n"
         "  poll                     — ожидать события карты (вставка/извлечение)\n"
+        "  stats [APDUhex] [N]      — статистика ридера (после N обменов APDU)\n"
+        "  trace-dump <файл.pcap> [APDUhex] [N] — последние кадры USB в pcap (usbmon)\n"
         );
     p.addHelpOption();
     p.addVersionOption();
@@ -77,10 +90,34 @@ int main(int argc, char *argv[])
                                   "Таймаут обмена, мс (по умолчанию 2000)", "MS", "2000");
     QCommandLineOption noDetachOpt(QStringList() << "no-detach",
                                    "Не отсоединять драйвер ядра/pcscd");
+    QCommandLineOption noPpsOpt(QStringList() << "no-pps",
+                                "Не согласовывать скорость (PPS) после подачи питания");
+    QCommandLineOption maxBaudOpt(QStringList() << "max-baud",
+                                  "Верхний предел скорости обмена с картой, бит/с (0 — без ограничения)", "BPS", "0");
     p.addOption(libOpt);
     p.addOption(vidOpt); p.addOption(pidOpt);
     p.addOption(protoOpt); p.addOption(ifOpt);
     p.addOption(timeoutOpt); p.addOption(noDetachOpt);
+    QCommandLineOption getRespOpt(QStringList() << "get-response",
+                                  "T=0: выполнять GET RESPONSE (61xx) и повтор с Le (6Cxx) в библиотеке");
+    p.addOption(noPpsOpt); p.addOption(maxBaudOpt);
+    p.addOption(getRespOpt);
+    QCommandLineOption pathOpt(QStringList() << "path",
+                               "Ридер по пути на шине (см. list), напр. 1-2.4", "PATH");
+    QCommandLineOption serialOpt(QStringList() << "serial",
+                                 "Ридер по серийному номеру USB", "SN");
+    p.addOption(pathOpt); p.addOption(serialOpt);
+    QCommandLineOption recordOpt(QStringList() << "record",
+                                 "Записать сессию (ATR и APDU) в файл для acr38replay", "ФАЙЛ");
+    QCommandLineOption replayOpt(QStringList() << "replay",
+                                 "Файл сессии для --lib acr38replay", "ФАЙЛ");
+    QCommandLineOption replayTimingOpt(QStringList() << "replay-timing",
+                                       "acr38replay: выдерживать записанное время обменов");
+    p.addOption(recordOpt); p.addOption(replayOpt); p.addOption(replayTimingOpt);
+    QCommandLineOption resetOpt(QStringList() << "reset",
+                                "Активация карты: cold|warm|reuse (reuse — сессия прошлого запуска, если карта не менялась)",
+                                "MODE", "cold");
+    p.addOption(resetOpt);
 
     p.addPositionalArgument("command", "Команда (см. описание выше)");
     p.addPositionalArgument("args", "Аргументы команды", "[args]");
@@ -90,13 +127,14 @@ int main(int argc, char *argv[])
 
     QString cmd = pos.at(0).toLower();
 
-    bool okv=false, okp=false, okif=false, okt=false;
+    bool okv=false, okp=false, okif=false, okt=false, okb=false;
     uint16_t vid = p.value(vidOpt).toUShort(&okv,16);
     uint16_t pid = p.value(pidOpt).toUShort(&okp,16);
     int iface = p.value(ifOpt).toInt(&okif,10);
     unsigned timeout = p.value(timeoutOpt).toUInt(&okt,10);
-    if (!okv || !okp || !okif || !okt){
-        std::cerr << "Ошибка: некорректные значения VID/PID/iface/timeout\n";
+    unsigned maxBaud = p.value(maxBaudOpt).toUInt(&okb,10);
+    if (!okv || !okp || !okif || !okt || !okb){
+        std::cerr << "Ошибка: некорректные значения VID/PID/iface/timeout/max-baud\n";
         return 2;
     }
 
@@ -106,6 +144,12 @@ int main(int argc, char *argv[])
     else if (ps=="t1") proto = IsoProtocol::T1;
     else if (ps!="auto") { std::cerr << "Ошибка: неизвестный протокол: "<< ps.toStdString() << "\n"; return 2; }
 
+    ResetMode reset = ResetMode::Cold;
+    QString rs = p.value(resetOpt).toLower();
+    if (rs=="warm") reset = ResetMode::Warm;
+    else if (rs=="reuse") reset = ResetMode::Reuse;
+    else if (rs!="cold") { std::cerr << "Ошибка: неизвестный режим сброса: "<< rs.toStdString() << "\n"; return 2; }
+
     // --- загрузка библиотеки ---
     QLibrary lib(p.value(libOpt));
     if (!lib.load()){
@@ -126,6 +170,22 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if (cmd=="list"){
+        using EnumFn = size_t(*)(uint16_t, uint16_t, ReaderLocation*, size_t);
+        auto enumerate = reinterpret_cast<EnumFn>(lib.resolve("enumerate_readers"));
+        if (!enumerate){ std::cerr << "Ошибка: библиотека не поддерживает enumerate_readers\n"; return 1; }
+        std::vector<ReaderLocation> locs(enumerate(vid, pid, nullptr, 0));
+        locs.resize(enumerate(vid, pid, locs.data(), locs.size()));
+        if (locs.empty()) std::cout << "Ридеры не найдены\n";
+        for (const auto& l : locs){
+            std::cout << readerPath(l) << "  0x" << std::hex << std::setfill('0')
+                      << std::setw(4) << l.vid << ":0x" << std::setw(4) << l.pid << std::dec
+                      << "  адрес " << int(l.address)
+                      << "  SN " << (l.serial[0] ? l.serial : "—") << "\n";
+        }
+        return 0;
+    }
+
     std::unique_ptr<ICardReader, DestroyFn> rdr(create(), destroy);
     if (!rdr){
         std::cerr << "Ошибка: create_reader() вернула null\n";
@@ -138,6 +198,14 @@ int main(int argc, char *argv[])
     par.detachKernelDriver = !p.isSet(noDetachOpt);
     par.interfaceHint = iface;
     par.ioTimeoutMs = timeout;
+    par.autoPps = !p.isSet(noPpsOpt);
+    par.maxBaud = maxBaud;
+    par.autoGetResponse = p.isSet(getRespOpt);
+    par.path = p.value(pathOpt).toStdString();
+    par.serial = p.value(serialOpt).toStdString();
+    par.recordFile = p.value(recordOpt).toStdString();
+    par.replayFile = p.value(replayOpt).toStdString();
+    par.replayTiming = p.isSet(replayTimingOpt);
 
     try {
         rdr->open(par);
@@ -149,10 +217,24 @@ int main(int argc, char *argv[])
                       << "VID:PID   : 0x" << std::hex << std::setfill('0')
                       << std::setw(4) << inf.vid << ":0x" << std::setw(4) << inf.pid << std::dec << "\n"
                       << "Бэкенд    : " << inf.backend << "\n"
+                      << "Путь/SN   : " << inf.path << " / " << (inf.serial.empty() ? "—" : inf.serial) << "\n"
                       << "Интерфейс/EP: bulk OUT=0x" << std::hex << int(inf.bulkOut)
                       << " IN=0x" << int(inf.bulkIn)
                       << (inf.hasInterrupt ? (std::string("  intr IN=0x") + [&]{std::ostringstream s;s<<std::hex<<int(inf.intrIn);return s.str();}()) : "")
-                      << std::dec << "\n";
+                      << std::dec << "\n"
+                      << "Уровень обмена: " << levelToStr(inf.level)
+                      << " (до " << inf.maxCommandData << "/" << inf.maxResponseData << " байт данных)\n";
+            if (inf.ccid.present){
+                const auto& d = inf.ccid;
+                std::cout << "CCID " << std::hex << (d.bcdCcid>>8) << "." << std::setw(2) << (d.bcdCcid&0xFF) << std::dec
+                          << ": протоколы=0x" << std::hex << d.protocols
+                          << " dwFeatures=0x" << std::setw(8) << d.features << std::dec << "\n"
+                          << "  dwMaxCCIDMessageLength=" << d.maxMessageLength
+                          << " dwMaxIFSD=" << d.maxIfsd << "\n"
+                          << "  частота " << d.defaultClockKHz << "/" << d.maxClockKHz << " кГц"
+                          << " (bNumClockSupported=" << int(d.numClockSupported) << ")"
+                          << ", скорость " << d.dataRate << "/" << d.maxDataRate << " бит/с\n";
+            }
             return 0;
         }
         else if (cmd=="status"){
@@ -161,8 +243,15 @@ int main(int argc, char *argv[])
             return 0;
         }
         else if (cmd=="poweron"){
-            auto atr = rdr->powerOn();
+            auto atr = rdr->powerOn(reset);
             std::cout << "ATR: " << toHex(atr) << "\n";
+            auto inf = rdr->info();
+            if (inf.activeProtocol >= 0){
+                std::cout << "Протокол: T=" << inf.activeProtocol
+                          << "  Fi/Di=0x" << std::hex << std::setfill('0') << std::setw(2) << int(inf.activeFiDi) << std::dec;
+                if (inf.activeBaud) std::cout << "  (" << inf.activeBaud << " бит/с)";
+                std::cout << "\n";
+            }
             return 0;
         }
         else if (cmd=="poweroff"){
@@ -173,10 +262,64 @@ int main(int argc, char *argv[])
         else if (cmd=="xfr"){
             if (pos.size()<2){ std::cerr << "Использование: xfr <APDUhex>\n"; return 2; }
             auto apdu = parseHex(pos.at(1));
+            using IntoFn = int(*)(ICardReader*, const uint8_t*, size_t, uint8_t*, size_t, size_t*, unsigned);
+            using ErrFn  = const char*(*)();
+            auto into = reinterpret_cast<IntoFn>(lib.resolve("reader_transmit_into"));
+            auto lastErr = reinterpret_cast<ErrFn>(lib.resolve("reader_last_error"));
+            if (into && lastErr){
+                static uint8_t rbuf[65536 + 2];
+                size_t n = 0;
+                if (into(rdr.get(), apdu.data(), apdu.size(), rbuf, sizeof(rbuf), &n, timeout) != READER_OK)
+                    throw ReaderError(lastErr());
+                std::cout << "R-APDU: " << toHex(std::vector<uint8_t>(rbuf, rbuf + n)) << "\n";
+                return 0;
+            }
             auto r = rdr->transmit(apdu, timeout);
             std::cout << "R-APDU: " << toHex(r.data) << "\n";
             return 0;
         }
+        else if (cmd=="stats"){
+            if (pos.size()>=2){
+                auto apdu = parseHex(pos.at(1));
+                bool okn = true;
+                const unsigned n = pos.size()>=3 ? pos.at(2).toUInt(&okn) : 1;
+                if (!okn){ std::cerr << "Некорректное число повторов\n"; return 2; }
+                rdr->powerOn(reset);
+                for (unsigned i=0; i<n; ++i) (void)rdr->transmit(apdu, timeout);
+            }
+            const auto st = rdr->stats();
+            std::cout << std::left << std::setw(18) << "Операция" << std::right
+                      << std::setw(8) << "N" << std::setw(9) << "мин" << std::setw(9) << "p50"
+                      << std::setw(9) << "p90" << std::setw(9) << "p99" << std::setw(9) << "p999"
+                      << std::setw(9) << "макс" << "  (мкс)\n";
+            for (size_t i=0; i<STAT_OPS; ++i){
+                const auto& l = st.latency[i];
+                if (!l.count) continue;
+                std::cout << std::left << std::setw(18) << statOpName(StatOp(i)) << std::right
+                          << std::setw(8) << l.count << std::setw(9) << l.minUs << std::setw(9) << l.p50Us
+                          << std::setw(9) << l.p90Us << std::setw(9) << l.p99Us << std::setw(9) << l.p999Us
+                          << std::setw(9) << l.maxUs << "\n";
+            }
+            std::cout << "Обменов: " << st.exchanges << "  байт OUT/IN: " << st.bytesOut << "/" << st.bytesIn
+                      << "  частичных IN: " << st.partialIn << "\n"
+                      << "Таймаутов: " << st.timeouts << "  повторов: " << st.retries
+                      << "  продлений WTX: " << st.timeExtensions << "  ошибок: " << st.errors << "\n";
+            return 0;
+        }
+        else if (cmd=="trace-dump"){
+            if (pos.size()<2){ std::cerr << "Использование: trace-dump <файл.pcap> [APDUhex] [N]\n"; return 2; }
+            if (pos.size()>=3){
+                auto apdu = parseHex(pos.at(2));
+                bool okn = true;
+                const unsigned n = pos.size()>=4 ? pos.at(3).toUInt(&okn) : 1;
+                if (!okn){ std::cerr << "Некорректное число повторов\n"; return 2; }
+                rdr->powerOn(reset);
+                for (unsigned i=0; i<n; ++i) (void)rdr->transmit(apdu, timeout);
+            }
+            const auto n = rdr->dumpTrace(pos.at(1).toStdString());
+            std::cout << "Записано пакетов: " << n << " → " << pos.at(1).toStdString() << "\n";
+            return 0;
+        }
         else if (cmd=="poll"){
             std::cout << "Ожидание событий карты (Ctrl+C — выход)…\n";
             CardPresence last = rdr->cardStatus();
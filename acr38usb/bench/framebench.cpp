@@ -0,0 +1,128 @@
+// Стенд кодека обменов: UsbEngine поверх FakeTransport, без ридера.
+// Меряет кадры/с и нс/кадр хостовой части — кадрирование, сборку ответа
+// из кусков, очередь движка, пул кадров, метрики и трассу.
+//   acr38usb_bench [итераций]
+#include "faketransport.h"
+#include "framepool.h"
+#include "metrics.h"
+#include "tracering.h"
+#include "usbengine.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+
+using namespace smartio;
+
+namespace {
+
+struct Scenario {
+    const char* name;
+    Framing framing;
+    size_t respLen;         // данных в ответе
+    size_t packet;          // кусок Bulk IN, 0 — ответ одной передачей
+    unsigned zlps;          // пустых передач перед ответом
+    unsigned delayUs;
+    bool instrumented;      // с ReaderMetrics и TraceRing
+    unsigned wtx = 0;       // ответов CCID «нужно больше времени» перед окончательным
+};
+
+std::vector<uint8_t> respond(const Scenario& s, const uint8_t* out){
+    std::vector<uint8_t> r;
+    if (s.framing == Framing::CCID) {
+        const uint32_t L = (uint32_t)s.respLen;
+        r = {0x80, uint8_t(L), uint8_t(L>>8), uint8_t(L>>16), uint8_t(L>>24), 0x00, out[6], 0x00, 0x00, 0x00};
+    } else {
+        r = {0x01, 0x00, uint8_t(s.respLen>>8), uint8_t(s.respLen)};
+    }
+    r.resize(r.size() + s.respLen, 0x00);
+    if (s.respLen >= 2) { r[r.size()-2] = 0x90; r[r.size()-1] = 0x00; }
+    return r;
+}
+
+Frame request(FramePool& pool, Framing f, uint8_t seq){
+    static const uint8_t apdu[] = {0x00, 0xB0, 0x00, 0x00, 0x00};
+    Frame fr = pool.acquire();
+    if (f == Framing::CCID) {
+        const uint8_t h[10] = {0x6F, sizeof(apdu), 0, 0, 0, 0x00, seq, 0x00, 0x00, 0x00};
+        std::memcpy(fr.data(), h, 10);
+        std::memcpy(fr.data() + 10, apdu, sizeof(apdu));
+        fr.resize(10 + sizeof(apdu));
+    } else {
+        const uint8_t h[4] = {0x01, 0xA0, 0x00, sizeof(apdu)};
+        std::memcpy(fr.data(), h, 4);
+        std::memcpy(fr.data() + 4, apdu, sizeof(apdu));
+        fr.resize(4 + sizeof(apdu));
+    }
+    return fr;
+}
+
+void report(const Scenario& s, const char* mode, size_t n, std::chrono::steady_clock::duration d){
+    const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    std::printf("%-6s %10zu %12.0f %10.0f  %s\n", mode, n, n / (ns / 1e9), ns / n, s.name);
+}
+
+void bench(const Scenario& s, size_t iters){
+    const size_t n = s.delayUs ? std::max<size_t>(iters / 100, 100) : iters;
+    FramePool pool;
+    pool.reset(nullptr, 512, 16);
+    ReaderMetrics metrics;
+    TraceRing trace;
+    UsbEngine engine(std::make_unique<FakeTransport>([&s](const uint8_t* out, size_t){
+        const auto r = respond(s, out);
+        FakeTransport::Script script;
+        for (unsigned i=0; i<s.wtx; ++i)
+            script.push_back({{0x80, 0, 0, 0, 0, 0x00, out[6], 0x80, 0x01, 0x00}, 0, XferStatus::Completed});
+        const auto body = FakeTransport::split(r.data(), r.size(), s.packet, s.zlps, s.delayUs);
+        script.insert(script.end(), body.begin(), body.end());
+        return script;
+    }));
+    engine.attach(0x02, 0x82, &pool, s.instrumented ? &metrics : nullptr, s.instrumented ? &trace : nullptr);
+
+    // синхронно: как ccidSend/acsSend, один обмен за раз
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i=0; i<n; ++i) {
+        Frame r = engine.run({s.framing, request(pool, s.framing, uint8_t(i)), 2000, {}, {}});
+        if (r.size() < 2) { std::fprintf(stderr, "%s: пустой ответ\n", s.name); std::exit(1); }
+    }
+    report(s, "run", n, std::chrono::steady_clock::now() - t0);
+
+    // очередью: как transmitAsync, все обмены выставлены сразу
+    std::promise<void> fin;
+    size_t left = n;
+    t0 = std::chrono::steady_clock::now();
+    for (size_t i=0; i<n; ++i) {
+        UsbExchange ex{s.framing, request(pool, s.framing, uint8_t(i)), 2000, {}, {}};
+        ex.done = [&](Frame&&, std::exception_ptr err){
+            if (err) { std::fprintf(stderr, "%s: ошибка обмена\n", s.name); std::exit(1); }
+            if (--left == 0) fin.set_value();
+        };
+        engine.submit(std::move(ex));
+    }
+    fin.get_future().wait();
+    report(s, "queue", n, std::chrono::steady_clock::now() - t0);
+    engine.detach();
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    const size_t iters = argc > 1 ? (size_t)std::strtoull(argv[1], nullptr, 10) : 100000;
+    const Scenario scenarios[] = {
+        {"CCID 2 байта", Framing::CCID, 2, 0, 0, 0, false},
+        {"CCID 2 байта +метрики/трасса", Framing::CCID, 2, 0, 0, 0, true},
+        {"CCID 258 байт", Framing::CCID, 258, 0, 0, 0, false},
+        {"CCID 258 байт пакетами по 64", Framing::CCID, 258, 64, 0, 0, false},
+        {"CCID 258 байт, ZLP перед ответом", Framing::CCID, 258, 0, 1, 0, false},
+        {"CCID 2 байта, задержка 50 мкс", Framing::CCID, 2, 0, 0, 50, false},
+        {"CCID 2 байта после 2 WTX", Framing::CCID, 2, 0, 0, 0, false, 2},
+        {"ACS 258 байт", Framing::ACS, 258, 0, 0, 0, false},
+        {"ACS 258 байт пакетами по 64", Framing::ACS, 258, 64, 0, 0, false},
+    };
+    std::printf("%-6s %10s %12s %10s  %s\n", "mode", "frames", "frames/s", "ns/frame", "сценарий");
+    for (const auto& s : scenarios) bench(s, iters);
+    return 0;
+}
@@ -0,0 +1,106 @@
+#ifndef ATR_H
+#define ATR_H
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace smartio {
+
+// Разобранный ATR (ISO/IEC 7816-3, историческая часть — 7816-4).
+struct AtrInfo {
+    bool valid = false;
+    bool inverse = false;            // TS=3F
+    std::optional<uint8_t> ta1, tb1, tc1, ta2;
+    uint8_t fi = 1, di = 1;          // индексы Fi/Di из TA1 (по умолчанию 0x11)
+    bool t0 = false, t1 = false;     // предложенные протоколы
+    uint8_t protocol = 0;            // первый предложенный (TD1), по умолчанию T=0
+    uint8_t wi = 10;                 // TC2 для T=0
+    bool specificMode = false;       // TA2 присутствует: PPS невозможен
+    uint8_t ifsc = 32;               // TA для T=1
+    uint8_t bwi = 4, cwi = 13;       // TB для T=1
+    bool crc = false;                // TC для T=1: EDC = CRC вместо LRC
+    std::vector<uint8_t> historical;
+    bool extendedLength = false;     // карточные возможности: расширенные Lc/Le
+    bool commandChaining = false;
+};
+
+// Таблицы 7 и 8 ISO/IEC 7816-3: F и fmax (кГц) по Fi, D по Di; 0 — RFU.
+inline unsigned atrF(uint8_t fi){
+    static const unsigned F[16] = {372,372,558,744,1116,1488,1860,0,0,512,768,1024,1536,2048,0,0};
+    return F[fi & 0x0F];
+}
+inline unsigned atrFmaxKHz(uint8_t fi){
+    static const unsigned f[16] = {4000,5000,6000,8000,12000,16000,20000,0,0,5000,7500,10000,15000,20000,0,0};
+    return f[fi & 0x0F];
+}
+inline unsigned atrD(uint8_t di){
+    static const unsigned D[16] = {0,1,2,4,8,16,32,64,12,20,0,0,0,0,0,0};
+    return D[di & 0x0F];
+}
+
+inline AtrInfo parseAtr(const std::vector<uint8_t>& atr){
+    AtrInfo a;
+    if (atr.size() < 2 || (atr[0]!=0x3B && atr[0]!=0x3F)) return a;
+    a.inverse = atr[0]==0x3F;
+    size_t idx = 1;
+    uint8_t y = atr[idx] >> 4;
+    const size_t k = atr[idx] & 0x0F;
+    ++idx;
+    int level = 1, proto = 0;
+    bool anyTd = false, t1Params = false;
+    while (true) {
+        uint8_t ta=0, tb=0, tc=0, td=0;
+        bool hasTa = y & 1, hasTb = y & 2, hasTc = y & 4, hasTd = y & 8;
+        if (hasTa) { if (idx>=atr.size()) return a; ta = atr[idx++]; }
+        if (hasTb) { if (idx>=atr.size()) return a; tb = atr[idx++]; }
+        if (hasTc) { if (idx>=atr.size()) return a; tc = atr[idx++]; }
+        if (hasTd) { if (idx>=atr.size()) return a; td = atr[idx++]; }
+
+        if (level==1) {
+            if (hasTa) { a.ta1 = ta; a.fi = ta>>4; a.di = ta&0x0F; }
+            if (hasTb) a.tb1 = tb;
+            if (hasTc) a.tc1 = tc;
+        } else if (level==2) {
+            if (hasTa) { a.ta2 = ta; a.specificMode = true; }
+            if (hasTc && proto==0) a.wi = tc;
+        } else if (proto==1 && !t1Params) {
+            // первые TAi/TBi/TCi после TD(i-1) с T=1
+            t1Params = true;
+            if (hasTa) a.ifsc = ta;
+            if (hasTb) { a.bwi = tb>>4; a.cwi = tb&0x0F; }
+            if (hasTc) a.crc = (tc & 0x01)!=0;
+        }
+        if (!hasTd) break;
+        proto = td & 0x0F;
+        if (!anyTd) a.protocol = (uint8_t)proto;
+        anyTd = true;
+        if (proto==0) a.t0 = true;
+        if (proto==1) a.t1 = true;
+        y = td >> 4;
+        ++level;
+    }
+    if (!anyTd) a.t0 = true;
+    if (idx + k > atr.size()) return a;
+    a.historical.assign(atr.begin()+idx, atr.begin()+idx+k);
+
+    // compact-TLV: категория 0x80 — вся историческая часть, 0x00 — кроме 3 байт статуса
+    const auto& h = a.historical;
+    if (!h.empty() && (h[0]==0x80 || h[0]==0x00)) {
+        const size_t end = (h[0]==0x00 && h.size()>=4) ? h.size()-3 : h.size();
+        for (size_t i=1; i<end; ) {
+            const uint8_t tag = h[i]>>4, len = h[i]&0x0F;
+            if (i+1+len > end) break;
+            if (tag==0x7 && len>=3) {
+                a.commandChaining = (h[i+3] & 0x80)!=0;
+                a.extendedLength  = (h[i+3] & 0x40)!=0;
+            }
+            i += 1 + len;
+        }
+    }
+    a.valid = true;
+    return a;
+}
+
+} // namespace smartio
+#endif // ATR_H
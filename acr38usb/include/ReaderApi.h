@@ -6,6 +6,9 @@
 #include <vector>
 #include <memory>
 #include <stdexcept>
+#include <exception>
+#include <functional>
+#include <future>
 
 #if defined(_WIN32)
 #define READER_API declspec(dllexport)
@@ -28,22 +31,156 @@ struct OpenParams {
     bool detachKernelDriver = true;
     int interfaceHint = -1;
     unsigned ioTimeoutMs = 2000;
+    bool autoPps = true;        // согласовать скорость (PPS) после powerOn
+    unsigned maxBaud = 0;       // верхний предел скорости, бит/с (0 — без ограничения)
+    bool autoGetResponse = false;   // T=0: 61xx/6Cxx обрабатываются библиотекой
+    std::string path;           // "шина-порт.порт…" (readerPath), пусто — любой
+    std::string serial;         // серийный номер USB, пусто — любой
+    // Файл сессии (SessionFile.h). Пустые поля берутся из SMARTIO_RECORD_FILE,
+    // SMARTIO_REPLAY_FILE и SMARTIO_REPLAY_TIMING.
+    std::string recordFile;     // ридер: писать ATR и пары C-APDU/R-APDU
+    std::string replayFile;     // библиотека acr38replay: откуда воспроизводить
+    bool replayTiming = false;  // acr38replay: выдерживать записанное время обменов
+};
+
+// Подключённый ридер (enumerate_readers). POD: передаётся через C-интерфейс.
+struct ReaderLocation {
+    uint16_t vid, pid;
+    uint8_t bus, address;
+    uint8_t portCount;
+    uint8_t ports[7];           // цепочка портов от корневого хаба
+    char serial[64];            // iSerialNumber, "" — нет или недоступен
+};
+
+// Путь в формате sysfs: "1-2.4".
+inline std::string readerPath(const ReaderLocation& l){
+    std::string s = std::to_string(l.bus);
+    for (uint8_t i=0; i<l.portCount; ++i) s += (i ? "." : "-") + std::to_string(l.ports[i]);
+    return s;
+}
+
+// Уровень обмена ридера (dwFeatures CCID).
+enum class ExchangeLevel { Character, Tpdu, ShortApdu, ExtendedApdu };
+
+// Функциональный дескриптор класса CCID (тип 0x21).
+struct CcidDescriptor {
+    bool present = false;
+    uint16_t bcdCcid = 0;
+    uint8_t maxSlotIndex = 0;
+    uint8_t voltageSupport = 0;
+    uint32_t protocols = 0;
+    uint32_t defaultClockKHz = 0, maxClockKHz = 0;
+    uint8_t numClockSupported = 0;
+    uint32_t dataRate = 0, maxDataRate = 0;     // бит/с
+    uint8_t numDataRatesSupported = 0;
+    uint32_t maxIfsd = 0;
+    uint32_t features = 0;
+    uint32_t maxMessageLength = 0;
 };
 
 struct ReaderInfo {
     std::string name;
+    std::string path, serial;
     uint16_t vid = 0, pid = 0;
     std::string backend;
     uint8_t bulkIn = 0, bulkOut = 0, intrIn = 0;
     bool hasInterrupt = false;
+
+    CcidDescriptor ccid;
+    ExchangeLevel level = ExchangeLevel::ShortApdu;
+    size_t maxCommandData = 255;    // максимум байт данных C-APDU за один transmit
+    size_t maxResponseData = 256;   // максимум байт данных R-APDU (без SW1 SW2)
+
+    // параметры текущей сессии карты (после powerOn)
+    int activeProtocol = -1;        // 0 — T=0, 1 — T=1, -1 — карта не активирована
+    uint8_t activeFiDi = 0x11;
+    unsigned activeBaud = 0;        // бит/с, 0 — неизвестно
 };
 
 enum class CardPresence { NotPresent, PresentInactive, PresentActive, Unknown };
 
+// Активация карты в powerOn.
+// Cold  — снять питание, если подано, и подать заново;
+// Warm  — сброс без снятия питания (неактивная карта включается как при Cold);
+// Reuse — вернуть ATR текущей сессии, если карта с тех пор активна и не менялась
+//         (cardStatus() и события слота), иначе Warm. Сессия переживает close()
+//         и повторный open() того же ридера в другом процессе.
+enum class ResetMode { Cold, Warm, Reuse };
+
 struct XfrResult {
     std::vector<uint8_t> data;
 };
 
+// Статистика ридера (ICardReader::stats). Задержки — время на шине USB от
+// выставления Bulk OUT до последнего байта ответа; Apdu — весь APDU целиком,
+// со всеми кадрами цепочек, GET RESPONSE и блоками T=1.
+enum class StatOp { Apdu, XfrBlock, IccPowerOn, IccPowerOff, GetSlotStatus, SetParameters,
+                    AcsExchangeT0, AcsExchangeT1, AcsOther };
+constexpr size_t STAT_OPS = 9;
+
+inline const char* statOpName(StatOp op){
+    static const char* names[STAT_OPS] = {"APDU", "XfrBlock", "IccPowerOn", "IccPowerOff", "GetSlotStatus",
+                                          "SetParameters", "ACS EXCHANGE_T0", "ACS EXCHANGE_T1", "ACS прочие"};
+    return names[(size_t)op];
+}
+
+struct LatencyStats {
+    uint64_t count = 0;
+    uint64_t minUs = 0, maxUs = 0, meanUs = 0;
+    uint64_t p50Us = 0, p90Us = 0, p99Us = 0, p999Us = 0;
+};
+
+struct ReaderStats {
+    LatencyStats latency[STAT_OPS];
+    uint64_t exchanges = 0;         // обменов Bulk OUT/IN
+    uint64_t bytesOut = 0, bytesIn = 0;
+    uint64_t partialIn = 0;         // ответ пришёл больше чем одним Bulk IN
+    uint64_t timeouts = 0;
+    uint64_t retries = 0;           // пустые Bulk IN, повторы блоков T=1, повторы с Le по 6Cxx
+    uint64_t timeExtensions = 0;    // ответы CCID с запросом продления времени (bStatus 0x80)
+    uint64_t errors = 0;
+};
+
+// Пакет команд для transmitBatch: C-APDU подряд в одном буфере.
+struct ApduBatch {
+    std::vector<uint8_t> data;
+    std::vector<size_t> offsets;        // начало команды i в data
+    std::vector<uint8_t> stopOnError;   // 1 — прервать пакет, если SW команды не 9000
+
+    void add(const uint8_t* capdu, size_t n, bool stop = false){
+        offsets.push_back(data.size());
+        data.insert(data.end(), capdu, capdu + n);
+        stopOnError.push_back(stop ? 1 : 0);
+    }
+    void add(const std::vector<uint8_t>& capdu, bool stop = false){ add(capdu.data(), capdu.size(), stop); }
+    void clear(){ data.clear(); offsets.clear(); stopOnError.clear(); }
+    size_t size() const { return offsets.size(); }
+    const uint8_t* apdu(size_t i) const { return data.data() + offsets[i]; }
+    size_t length(size_t i) const { return (i+1<offsets.size() ? offsets[i+1] : data.size()) - offsets[i]; }
+};
+
+// Ответы пакета подряд в одном буфере (с SW). count() меньше числа команд —
+// пакет остановлен по stopOnError на последней выполненной.
+struct BatchResult {
+    std::vector<uint8_t> data;
+    std::vector<size_t> offsets;
+
+    size_t count() const { return offsets.size(); }
+    const uint8_t* response(size_t i) const { return data.data() + offsets[i]; }
+    size_t length(size_t i) const { return (i+1<offsets.size() ? offsets[i+1] : data.size()) - offsets[i]; }
+    uint16_t sw(size_t i) const {
+        const size_t n = length(i);
+        return n<2 ? 0 : uint16_t((response(i)[n-2]<<8) | response(i)[n-1]);
+    }
+};
+
+// Смена состояния карты в слоте (по уведомлению ридера, без опроса шины).
+// Unknown — ридер сообщил о событии, но не о состоянии: его даст cardStatus().
+using CardEventCallback = std::function<void(unsigned slot, CardPresence state)>;
+
+// Завершение асинхронного обмена: либо результат, либо исключение (err != nullptr).
+using XfrCallback = std::function<void(XfrResult&& result, std::exception_ptr err)>;
+
 class ICardReader {
 public:
     virtual ~ICardReader() = default;
@@ -53,20 +190,60 @@ public:
     virtual ReaderInfo info() const = 0;
 
     virtual CardPresence cardStatus() = 0;
-    virtual std::vector<uint8_t> powerOn() = 0;
+    virtual std::vector<uint8_t> powerOn(ResetMode mode = ResetMode::Cold) = 0;
     virtual void powerOff() = 0;
     virtual bool waitCardEvent(unsigned timeoutMs) = 0;
+    // Вызывается из потока событий USB; синхронные обмены из него невозможны.
+    virtual void setCardEventCallback(CardEventCallback cb) = 0;
 
     virtual XfrResult transmit(const std::vector<uint8_t>& capdu,
                                unsigned timeoutMs = 2000) = 0;
 
+    // APDU ставится в очередь ридера; done вызывается из потока событий USB.
+    virtual void transmitAsync(const std::vector<uint8_t>& capdu,
+                               XfrCallback done,
+                               unsigned timeoutMs = 2000) = 0;
+
+    // Команды выполняются подряд, без чужих обменов между ними.
+    virtual BatchResult transmitBatch(const ApduBatch& batch, unsigned timeoutMs = 2000) = 0;
+
+    std::future<XfrResult> transmitAsync(const std::vector<uint8_t>& capdu,
+                                         unsigned timeoutMs = 2000) {
+        auto pr = std::make_shared<std::promise<XfrResult>>();
+        auto fut = pr->get_future();
+        transmitAsync(capdu, [pr](XfrResult&& r, std::exception_ptr err){
+            if (err) pr->set_exception(err); else pr->set_value(std::move(r));
+        }, timeoutMs);
+        return fut;
+    }
+
     virtual std::vector<uint8_t> vendorControl(const std::vector<uint8_t>& payload) = 0;
+
+    // Снимок статистики; reset — обнулить после снимка.
+    virtual ReaderStats stats(bool reset = false) = 0;
+    // Последние кадры USB в pcap (usbmon, LINKTYPE_USB_LINUX); число пакетов.
+    virtual size_t dumpTrace(const std::string& pcapPath) = 0;
+};
+
+// Коды возврата reader_transmit_into; текст ошибки — reader_last_error().
+enum : int {
+    READER_OK        = 0,
+    READER_E_ARGS    = -1,   // нулевые указатели
+    READER_E_BUFFER  = -2,   // ответ не помещается в cap байт
+    READER_E_READER  = -3    // ошибка ридера/карты (ReaderError)
 };
 
 extern "C" {
 READER_API ICardReader* create_reader();
 READER_API void         destroy_reader(ICardReader*);
 READER_API const char*  reader_library_version();
+// Ридеры vid:pid (0 — любой). Заполняет до cap записей, возвращает общее число.
+READER_API size_t       enumerate_readers(uint16_t vid, uint16_t pid, ReaderLocation* out, size_t cap);
+// APDU без std::vector на границе библиотеки: ответ пишется в память вызывающего.
+READER_API int          reader_transmit_into(ICardReader* r, const uint8_t* capdu, size_t len,
+                                             uint8_t* rapdu, size_t cap, size_t* outLen, unsigned timeoutMs);
+// Текст последней ошибки reader_transmit_into в этом потоке.
+READER_API const char*  reader_last_error();
 }
 
 } // namespace smartio
@@ -2,4 +2,71 @@
 #define READERAPI_HPP
 #pragma once
 #include "ReaderApi.h"
+
+namespace smartio {
+
+// Набор ридеров одного процесса: каждый найденный ридер открывается и
+// занимается ровно одним экземпляром ICardReader. Экземпляры независимы,
+// обмены с разными ридерами можно вести параллельно из разных потоков.
+// Функции библиотеки передаются явно: приложения загружают её динамически.
+class ReaderPool {
+public:
+    using CreateFn    = ICardReader*(*)();
+    using DestroyFn   = void(*)(ICardReader*);
+    using EnumerateFn = size_t(*)(uint16_t, uint16_t, ReaderLocation*, size_t);
+
+    ReaderPool(CreateFn create, DestroyFn destroy, EnumerateFn enumerate)
+        : create_(create), destroy_(destroy), enumerate_(enumerate) {}
+    ReaderPool(const ReaderPool&) = delete;
+    ReaderPool& operator=(const ReaderPool&) = delete;
+    ~ReaderPool() { close(); }
+
+    // Открывает до maxCount ридеров base.vid:base.pid (0 — все найденные).
+    // Ридеры, которые не удалось открыть, пропускаются (см. errors()).
+    size_t open(const OpenParams& base, size_t maxCount = 0){
+        close();
+        std::vector<ReaderLocation> found(enumerate_(base.vid, base.pid, nullptr, 0));
+        found.resize(enumerate_(base.vid, base.pid, found.data(), found.size()));
+        for (const auto& loc : found) {
+            if (maxCount && readers_.size() >= maxCount) break;
+            std::unique_ptr<ICardReader, DestroyFn> r(create_(), destroy_);
+            if (!r) { errors_.push_back(readerPath(loc) + ": create_reader() вернула null"); continue; }
+            OpenParams p = base;
+            p.path = readerPath(loc);
+            p.serial.clear();
+            try {
+                r->open(p);
+            } catch (const std::exception& e) {
+                errors_.push_back(p.path + ": " + e.what());
+                continue;
+            }
+            readers_.push_back(std::move(r));
+            locations_.push_back(loc);
+        }
+        return readers_.size();
+    }
+
+    void close(){
+        for (auto& r : readers_) { try { r->close(); } catch (...) {} }
+        readers_.clear();
+        locations_.clear();
+        errors_.clear();
+    }
+
+    size_t size() const { return readers_.size(); }
+    ICardReader& at(size_t i) { return *readers_.at(i); }
+    const ReaderLocation& location(size_t i) const { return locations_.at(i); }
+    const std::vector<std::string>& errors() const { return errors_; }
+
+private:
+    CreateFn create_;
+    DestroyFn destroy_;
+    EnumerateFn enumerate_;
+    std::vector<std::unique_ptr<ICardReader, DestroyFn>> readers_;
+    std::vector<ReaderLocation> locations_;
+    std::vector<std::string> errors_;
+};
+
+} // namespace smartio
+
 #endif // READERAPI_HPP
@@ -0,0 +1,105 @@
+#ifndef SESSIONFILE_H
+#define SESSIONFILE_H
+#pragma once
+#include "ReaderApi.h"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace smartio {
+
+// Файл сессии ридера: пишется Acr38Usb (OpenParams::recordFile),
+// воспроизводится библиотекой acr38replay. Текст, запись на строку:
+//   SMARTIO-SESSION 1
+//   atr <мкс> <ATR hex>
+//   xfr <мкс> <C-APDU hex> <R-APDU hex>
+//   off
+// мкс — время операции на ридере, для воспроизведения в исходном темпе.
+struct SessionRecord {
+    enum class Kind { Atr, Xfr, Off } kind = Kind::Xfr;
+    uint64_t us = 0;
+    std::vector<uint8_t> cmd, rsp;      // для Atr ATR лежит в rsp
+};
+
+constexpr const char* SESSION_MAGIC = "SMARTIO-SESSION 1";
+
+inline std::string sessionHex(const uint8_t* p, size_t n){
+    static const char* d = "0123456789ABCDEF";
+    std::string s(n*2, '0');
+    for (size_t i=0; i<n; ++i) { s[2*i] = d[p[i]>>4]; s[2*i+1] = d[p[i]&0x0F]; }
+    return s.empty() ? "-" : s;
+}
+
+inline std::vector<uint8_t> sessionBytes(const std::string& hex){
+    std::vector<uint8_t> v;
+    if (hex == "-") return v;
+    if (hex.size() % 2) throw ReaderError("Сессия: нечётная длина hex");
+    v.reserve(hex.size()/2);
+    for (size_t i=0; i<hex.size(); i+=2) v.push_back((uint8_t)std::stoul(hex.substr(i, 2), nullptr, 16));
+    return v;
+}
+
+inline std::vector<SessionRecord> readSession(const std::string& path){
+    std::ifstream in(path);
+    if (!in) throw ReaderError("Не удалось открыть файл сессии: " + path);
+    std::string line;
+    if (!std::getline(in, line) || line.rfind(SESSION_MAGIC, 0) != 0)
+        throw ReaderError("Не файл сессии: " + path);
+    std::vector<SessionRecord> out;
+    for (size_t no = 2; std::getline(in, line); ++no) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ls(line);
+        std::string kind, a, b;
+        SessionRecord r;
+        ls >> kind;
+        try {
+            if (kind == "atr")      { r.kind = SessionRecord::Kind::Atr; ls >> r.us >> a; r.rsp = sessionBytes(a); }
+            else if (kind == "xfr") { ls >> r.us >> a >> b; r.cmd = sessionBytes(a); r.rsp = sessionBytes(b); }
+            else if (kind == "off") r.kind = SessionRecord::Kind::Off;
+            else throw ReaderError("неизвестная запись " + kind);
+        } catch (const std::exception& e) {
+            throw ReaderError("Сессия " + path + ", строка " + std::to_string(no) + ": " + e.what());
+        }
+        out.push_back(std::move(r));
+    }
+    return out;
+}
+
+// Запись сессии; безопасна из нескольких потоков (обмены завершаются в потоке событий).
+class SessionWriter {
+public:
+    explicit SessionWriter(const std::string& path) : f_(std::fopen(path.c_str(), "w")) {
+        if (!f_) throw ReaderError("Не удалось создать файл сессии: " + path);
+        std::fprintf(f_, "%s\n", SESSION_MAGIC);
+    }
+    ~SessionWriter() { std::fclose(f_); }
+    SessionWriter(const SessionWriter&) = delete;
+    SessionWriter& operator=(const SessionWriter&) = delete;
+
+    void atr(uint64_t us, const std::vector<uint8_t>& atr){
+        std::lock_guard<std::mutex> lk(m_);
+        std::fprintf(f_, "atr %llu %s\n", (unsigned long long)us, sessionHex(atr.data(), atr.size()).c_str());
+        std::fflush(f_);
+    }
+    void xfr(uint64_t us, const uint8_t* c, size_t cn, const uint8_t* r, size_t rn){
+        std::lock_guard<std::mutex> lk(m_);
+        std::fprintf(f_, "xfr %llu %s %s\n", (unsigned long long)us,
+                     sessionHex(c, cn).c_str(), sessionHex(r, rn).c_str());
+    }
+    void off(){
+        std::lock_guard<std::mutex> lk(m_);
+        std::fprintf(f_, "off\n");
+        std::fflush(f_);
+    }
+
+private:
+    std::FILE* f_;
+    std::mutex m_;
+};
+
+} // namespace smartio
+#endif // SESSIONFILE_H
@@ -1,5 +1,9 @@
 #include "acr38usb.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
@@ -8,23 +12,86 @@ namespace smartio {
 namespace {
 constexpr uint8_t USB_CLASS_CCID = 0x0B;
 
+constexpr uint8_t PC_to_RDR_SetParameters = 0x61;
 constexpr uint8_t PC_to_RDR_IccPowerOn    = 0x62;
 constexpr uint8_t PC_to_RDR_IccPowerOff   = 0x63;
 constexpr uint8_t PC_to_RDR_GetSlotStatus = 0x65;
+constexpr uint8_t PC_to_RDR_GetParameters = 0x6C;
 constexpr uint8_t PC_to_RDR_XfrBlock      = 0x6F;
 constexpr uint8_t RDR_to_PC_DataBlock     = 0x80;
 constexpr uint8_t RDR_to_PC_SlotStatus    = 0x81;
+constexpr uint8_t RDR_to_PC_NotifySlotChange = 0x50;
 
 constexpr uint8_t ACS_HDR           = 0x01;
 constexpr uint8_t ACS_GET_ACR_STAT  = 0x01;
 constexpr uint8_t ACS_RESET_DEFAULT = 0x80;
 constexpr uint8_t ACS_POWER_OFF     = 0x81;
+constexpr uint8_t ACS_SET_CARD_PPS  = 0x0A;   // PPS карте, ридер переходит на новую скорость
 constexpr uint8_t ACS_EXCHANGE_T0   = 0xA0;
+constexpr uint8_t ACS_EXCHANGE_T1   = 0xA1;   // блок T=1 целиком (пролог + INF + EDC)
+constexpr unsigned ACS_CLOCK_KHZ    = 4000;
+
+// wLevelParameter / bChainParameter
+constexpr uint16_t CHAIN_NONE     = 0x0000;
+constexpr uint16_t CHAIN_BEGIN    = 0x0001;
+constexpr uint16_t CHAIN_END      = 0x0002;
+constexpr uint16_t CHAIN_MIDDLE   = 0x0003;
+constexpr uint16_t CHAIN_CONTINUE = 0x0010;
+
+constexpr size_t DEFAULT_MAX_MSG = 10 + 261;   // заголовок CCID + короткий APDU
+constexpr size_t POOL_FRAMES     = 4;
+constexpr size_t T1_MAX_IFSD     = 254;
+constexpr int    MAX_T0_ROUNDS   = 64;     // GET RESPONSE / повторов с Le на один APDU
+
+constexpr uint8_t  CCID_DESC_TYPE   = 0x21;
+constexpr uint8_t  CCID_DESC_LEN    = 0x36;
+constexpr uint32_t FEAT_AUTO_ATR    = 0x00000002;   // параметры по ATR выставляет ридер
+constexpr uint32_t FEAT_AUTO_NEGO   = 0x00000040;   // ридер сам согласует параметры
+constexpr uint32_t FEAT_AUTO_PPS    = 0x00000080;   // PPS по SetParameters делает ридер
+constexpr uint32_t FEAT_TPDU        = 0x00010000;
+constexpr uint32_t FEAT_SHORT_APDU  = 0x00020000;
+constexpr uint32_t FEAT_EXT_APDU    = 0x00040000;
 
 static uint32_t le32(const uint8_t* p){
     return (uint32_t)p[0] | ((uint32_t)p[1]<<8) | ((uint32_t)p[2]<<16) | ((uint32_t)p[3]<<24);
 }
 
+// Поиск функционального дескриптора CCID среди class-specific дескрипторов.
+static bool parseCcidDescriptor(const unsigned char* extra, int len, CcidDescriptor& d){
+    for (int off=0; extra && off+2<=len && extra[off]>=2; off += extra[off]){
+        const uint8_t* p = extra + off;
+        if (p[1]!=CCID_DESC_TYPE || p[0]<CCID_DESC_LEN || off+CCID_DESC_LEN>len) continue;
+        d.present = true;
+        d.bcdCcid = (uint16_t)(p[2] | (p[3]<<8));
+        d.maxSlotIndex = p[4];
+        d.voltageSupport = p[5];
+        d.protocols = le32(p+6);
+        d.defaultClockKHz = le32(p+10);
+        d.maxClockKHz = le32(p+14);
+        d.numClockSupported = p[18];
+        d.dataRate = le32(p+19);
+        d.maxDataRate = le32(p+23);
+        d.numDataRatesSupported = p[27];
+        d.maxIfsd = le32(p+28);
+        d.features = le32(p+40);
+        d.maxMessageLength = le32(p+44);
+        return true;
+    }
+    return false;
+}
+
+// Ответ T=0 требует продолжения: 61xx — GET RESPONSE, 6Cxx — повтор с верным Le.
+static bool t0Pending(const uint8_t* data, size_t n){
+    return n >= 2 && (data[n-2]==0x61 || data[n-2]==0x6C);
+}
+
+static ExchangeLevel levelFromFeatures(uint32_t f){
+    if (f & FEAT_EXT_APDU)   return ExchangeLevel::ExtendedApdu;
+    if (f & FEAT_SHORT_APDU) return ExchangeLevel::ShortApdu;
+    if (f & FEAT_TPDU)       return ExchangeLevel::Tpdu;
+    return ExchangeLevel::Character;
+}
+
 }
 
 std::string Acr38Usb::libusbErr(int r){
@@ -32,27 +99,55 @@ std::string Acr38Usb::libusbErr(int r){
     return os.str();
 }
 
-Acr38Usb::Acr38Usb() {
-    if (int r = libusb_init(&ctx_); r != 0) throw ReaderError(libusbErr(r));
-    libusb_set_option(ctx_, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_NONE);
+Acr38Usb::Acr38Usb() : usb_(UsbContext::instance()) {
+    auto io = std::make_unique<LibusbTransport>(usb_);
+    io_ = io.get();
+    engine_ = std::make_unique<UsbEngine>(std::move(io));
+    t1_.countRetries(&metrics_.retries);
 }
 
 Acr38Usb::~Acr38Usb() {
     try { close(); } catch (...) {}
-    if (ctx_) libusb_exit(ctx_);
+    engine_.reset();
 }
 
 void Acr38Usb::open(const OpenParams& p){
     if (h_) close();
+    waitClosed();
     ioTimeoutMs_ = p.ioTimeoutMs;
     iso_ = p.protocol;
+    autoPps_ = p.autoPps;
+    maxBaud_ = p.maxBaud;
+    autoGetResponse_ = p.autoGetResponse;
     findAndClaim(p);
+    std::string rec = p.recordFile;
+    if (rec.empty()) if (const char* e = std::getenv("SMARTIO_RECORD_FILE")) rec = e;
+    if (!rec.empty()) recorder_ = std::make_unique<SessionWriter>(rec);
 }
 
 void Acr38Usb::close(){
-    releaseIf();
-    if (h_) { libusb_close(h_); h_ = nullptr; }
+    t1Queue_.stop();
+    engine_->detach();
+    libusb_device_handle* h = h_;
+    const int ifNum = ifNum_;
+    h_ = nullptr;
+    if (!engine_->onEventThread()) {
+        waitClosed();
+        finishClose(h, ifNum);
+    } else if (h) {
+        // из callback'а отменённые передачи ещё в полёте: интерфейс, пул и дескриптор
+        // освобождаются после последней из них; open() и close() из других потоков ждут
+        { std::lock_guard<std::mutex> lk(closeMutex_); closing_ = true; }
+        engine_->whenIdle([this, h, ifNum]{ finishClose(h, ifNum); });
+    }
+    recorder_.reset();
     ifNum_ = -1; epBulkIn_ = epBulkOut_ = 0; epIntrIn_.reset();
+    ccidDesc_ = {};
+    loc_ = {};
+    atr_.clear(); atrInfo_ = {}; activeProto_ = -1; activeFiDi_ = 0x11;
+    std::lock_guard<std::mutex> lk(presMutex_);
+    listening_ = presenceValid_ = cardIn_ = powered_ = false;
+    presCv_.notify_all();
 }
 
 ReaderInfo Acr38Usb::info() const {
@@ -63,194 +158,567 @@ ReaderInfo Acr38Usb::info() const {
     i.intrIn = i.hasInterrupt ? *epIntrIn_ : 0;
     i.backend = (backend_ == Backend::CCID) ? "CCID" : "ACS";
     i.name = "ACR38 USB Reader";
+    if (h_) { i.path = readerPath(loc_); i.serial = loc_.serial; }
+    i.ccid = ccidDesc_;
+    i.level = level_;
+    i.activeProtocol = activeProto_;
+    i.activeFiDi = activeFiDi_;
+    if (activeProto_ >= 0) {
+        const unsigned clk = (backend_==Backend::CCID && ccidDesc_.defaultClockKHz) ? ccidDesc_.defaultClockKHz : ACS_CLOCK_KHZ;
+        if (const unsigned F = atrF(activeFiDi_>>4)) i.activeBaud = (unsigned)((uint64_t)clk*1000*atrD(activeFiDi_&0x0F)/F);
+    }
+    const size_t payload = maxMessage() - 10;
+    if (hostT1()) {
+        // цепочки T=1 снимают ограничение сообщения ридера
+        i.maxCommandData  = 65535;
+        i.maxResponseData = 65536;
+    } else if (level_ == ExchangeLevel::ExtendedApdu) {
+        i.maxCommandData  = std::min<size_t>(65535, payload - 9);
+        i.maxResponseData = std::min<size_t>(65536, payload - 2);
+    } else {
+        i.maxCommandData  = std::min<size_t>(255, payload - 5);
+        i.maxResponseData = std::min<size_t>(256, payload - 2);
+    }
     return i;
 }
 
-void Acr38Usb::findAndClaim(const OpenParams& p){
-    vid_ = p.vid; pid_ = p.pid;
+size_t Acr38Usb::maxMessage() const {
+    if (backend_ == Backend::CCID && ccidDesc_.present && ccidDesc_.maxMessageLength > 10 + 5)
+        return ccidDesc_.maxMessageLength;
+    return DEFAULT_MAX_MSG;
+}
 
-    libusb_device** list = nullptr;
-    ssize_t n = libusb_get_device_list(ctx_, &list);
-    if (n < 0) throw ReaderError("libusb_get_device_list завершилась ошибкой");
+void Acr38Usb::readSerial(libusb_device_handle* h, const libusb_device_descriptor& t, ReaderLocation& l){
+    l.serial[0] = 0;
+    if (!t.iSerialNumber) return;
+    const int r = libusb_get_string_descriptor_ascii(h, t.iSerialNumber,
+                                                     reinterpret_cast<unsigned char*>(l.serial), sizeof(l.serial));
+    l.serial[r > 0 ? std::min<size_t>(r, sizeof(l.serial)-1) : 0] = 0;
+}
 
-    libusb_device* chosen = nullptr;
-    libusb_device_descriptor dd{};
-    libusb_config_descriptor* cfg = nullptr;
+std::vector<ReaderLocation> Acr38Usb::enumerate(uint16_t vid, uint16_t pid){
+    auto usb = UsbContext::instance();
+    std::vector<ReaderLocation> out;
+    for (auto& u : usb->devices(vid, pid)) {
+        if (!u.serialKnown) {
+            // серийный номер читается и у занятого другим процессом ридера: claim не нужен
+            libusb_device_handle* h = nullptr;
+            if (libusb_open(u.dev.get(), &h) == 0) {
+                readSerial(h, u.dd, u.loc);
+                libusb_close(h);
+                usb->rememberSerial(readerPath(u.loc), u.loc.serial);
+            }
+        }
+        out.push_back(u.loc);
+    }
+    return out;
+}
 
-    for (ssize_t i=0;i<n && !chosen;++i){
-        libusb_device* d = list[i];
-        libusb_device_descriptor t{};
-        if (libusb_get_device_descriptor(d,&t)==0 && t.idVendor==p.vid && t.idProduct==p.pid){
-            if (libusb_get_active_config_descriptor(d, &cfg)!=0){
-                if (libusb_get_config_descriptor(d, 0, &cfg)!=0) continue;
+bool Acr38Usb::parseLayout(const libusb_config_descriptor* cfg, int hint, InterfaceLayout& l){
+    for (uint8_t ii=0; ii<cfg->bNumInterfaces; ++ii){
+        const auto& alt = cfg->interface[ii];
+        for (int a=0;a<alt.num_altsetting;++a){
+            const auto* ifd = &alt.altsetting[a];
+            uint8_t in=0, out=0; std::optional<uint8_t> intr;
+            uint16_t inMax=64;
+            for (uint8_t e=0;e<ifd->bNumEndpoints;++e){
+                const auto& ep = ifd->endpoint[e];
+                const uint8_t addr = ep.bEndpointAddress;
+                const uint8_t type = ep.bmAttributes & 0x03;
+                const bool dirIn = (addr & 0x80)!=0;
+                if (type==LIBUSB_TRANSFER_TYPE_BULK && dirIn)  { in = addr; inMax = ep.wMaxPacketSize & 0x7FF; }
+                if (type==LIBUSB_TRANSFER_TYPE_BULK && !dirIn) out = addr;
+                if (type==LIBUSB_TRANSFER_TYPE_INTERRUPT && dirIn) intr = addr;
             }
-            for (uint8_t ii=0; ii<cfg->bNumInterfaces; ++ii){
-                const auto& alt = cfg->interface[ii];
-                for (int a=0;a<alt.num_altsetting;++a){
-                    const auto* ifd = &alt.altsetting[a];
-                    uint8_t in=0, out=0; std::optional<uint8_t> intr;
-                    for (uint8_t e=0;e<ifd->bNumEndpoints;++e){
-                        const auto& ep = ifd->endpoint[e];
-                        const uint8_t addr = ep.bEndpointAddress;
-                        const uint8_t type = ep.bmAttributes & 0x03;
-                        const bool dirIn = (addr & 0x80)!=0;
-                        if (type==LIBUSB_TRANSFER_TYPE_BULK && dirIn)  in = addr;
-                        if (type==LIBUSB_TRANSFER_TYPE_BULK && !dirIn) out = addr;
-                        if (type==LIBUSB_TRANSFER_TYPE_INTERRUPT && dirIn) intr = addr;
-                    }
-                    if (in && out && (p.interfaceHint==-1 || p.interfaceHint==ifd->bInterfaceNumber)) {
-                        epBulkIn_ = in; epBulkOut_ = out; epIntrIn_ = intr;
-                        ifNum_ = ifd->bInterfaceNumber;
-                        backend_ = (ifd->bInterfaceClass == USB_CLASS_CCID) ? Backend::CCID : Backend::ACS;
-                        chosen = d; dd = t; break;
-                    }
-                }
+            if (in && out && (hint==-1 || hint==ifd->bInterfaceNumber)) {
+                l = {};
+                l.epIn = in; l.epOut = out; l.epIntr = intr;
+                l.inMaxPacket = inMax ? inMax : 64;
+                l.ifNum = ifd->bInterfaceNumber;
+                l.ccid = ifd->bInterfaceClass == USB_CLASS_CCID;
+                // ранние ридеры кладут дескриптор в extra последней конечной точки
+                if (l.ccid && !parseCcidDescriptor(ifd->extra, ifd->extra_length, l.desc) && ifd->bNumEndpoints)
+                    parseCcidDescriptor(ifd->endpoint[ifd->bNumEndpoints-1].extra,
+                                        ifd->endpoint[ifd->bNumEndpoints-1].extra_length, l.desc);
+                return true;
             }
-            libusb_free_config_descriptor(cfg); cfg = nullptr;
         }
     }
-    libusb_free_device_list(list, 1);
+    return false;
+}
+
+void Acr38Usb::applyLayout(const InterfaceLayout& l){
+    epBulkIn_ = l.epIn; epBulkOut_ = l.epOut; epIntrIn_ = l.epIntr;
+    inMaxPacket_ = l.inMaxPacket;
+    ifNum_ = l.ifNum;
+    backend_ = l.ccid ? Backend::CCID : Backend::ACS;
+    ccidDesc_ = l.desc;
+    if (l.ccid) level_ = ccidDesc_.present ? levelFromFeatures(ccidDesc_.features) : ExchangeLevel::ShortApdu;
+    else level_ = ExchangeLevel::Tpdu;   // ACS EXCHANGE_T0 передаёт TPDU как есть
+}
+
+// Устройства берутся из таблицы UsbContext, разбор интерфейса — из кэша по пути.
+// Ридер подходит, но может быть занят (другим процессом или экземпляром в этом же):
+// тогда поиск продолжается со следующего устройства.
+void Acr38Usb::findAndClaim(const OpenParams& p){
+    vid_ = p.vid; pid_ = p.pid;
 
-    if (!chosen) throw ReaderError("ACR38: не найден интерфейс с парой Bulk IN/OUT");
+    std::string lastErr;
+    for (auto& u : usb_->devices(p.vid, p.pid)) {
+        if (h_) break;
+        const std::string path = readerPath(u.loc);
+        if (!p.path.empty() && path!=p.path) continue;
+        if (!p.serial.empty() && u.serialKnown && p.serial!=u.loc.serial) continue;
+
+        std::ostringstream key;
+        key<<path<<'/'<<std::hex<<u.dd.idVendor<<':'<<u.dd.idProduct<<'/'<<std::dec<<p.interfaceHint;
+        auto layout = usb_->layout(key.str());
+        if (!layout) {
+            libusb_config_descriptor* cfg = nullptr;
+            if (libusb_get_active_config_descriptor(u.dev.get(), &cfg)!=0 &&
+                libusb_get_config_descriptor(u.dev.get(), 0, &cfg)!=0) continue;
+            InterfaceLayout l;
+            const bool ok = parseLayout(cfg, p.interfaceHint, l);
+            libusb_free_config_descriptor(cfg);
+            if (!ok) { lastErr = "ACR38: не найден интерфейс с парой Bulk IN/OUT"; continue; }
+            usb_->storeLayout(key.str(), l);
+            layout = l;
+        }
+
+        libusb_device_handle* h = nullptr;
+        if (libusb_open(u.dev.get(), &h) != 0) { lastErr = "Не удалось открыть устройство (libusb_open)"; continue; }
+        if (!u.serialKnown) {
+            readSerial(h, u.dd, u.loc);
+            usb_->rememberSerial(path, u.loc.serial);
+        }
+        if (!p.serial.empty() && p.serial != u.loc.serial) { libusb_close(h); continue; }
+        if (p.detachKernelDriver && libusb_kernel_driver_active(h, layout->ifNum)==1)
+            libusb_detach_kernel_driver(h, layout->ifNum);
+        if (int r = libusb_claim_interface(h, layout->ifNum); r != 0) {
+            lastErr = std::string("Не удалось занять интерфейс: ") + libusbErr(r);
+            libusb_close(h);
+            continue;
+        }
+        h_ = h;
+        applyLayout(*layout);
+        loc_ = u.loc;
+        vid_ = u.dd.idVendor; pid_ = u.dd.idProduct;
+    }
 
-    if (libusb_open(chosen, &h_) != 0) throw ReaderError("Не удалось открыть устройство (libusb_open)");
-    if (p.detachKernelDriver && libusb_kernel_driver_active(h_, ifNum_)==1)
-        libusb_detach_kernel_driver(h_, ifNum_);
-    if (int r = libusb_claim_interface(h_, ifNum_); r != 0)
-        throw ReaderError(std::string("Не удалось занять интерфейс: ") + libusbErr(r));
+    if (!h_) {
+        if (!lastErr.empty()) throw ReaderError(lastErr);
+        if (!p.serial.empty()) throw ReaderError("ACR38: не найден ридер с серийным номером " + p.serial);
+        throw ReaderError("ACR38: ридер не найден");
+    }
 
-    vid_ = dd.idVendor; pid_ = dd.idProduct;
+    // кадр пула вмещает самое длинное сообщение ридера: один Bulk IN на ответ
+    const size_t frame = (maxMessage() + inMaxPacket_ - 1) / inMaxPacket_ * inMaxPacket_;
+    pool_.reset(h_, frame, POOL_FRAMES);
+    trace_.setDevice(loc_.bus, loc_.address);
+    io_->setHandle(h_);
+    engine_->attach(epBulkOut_, epBulkIn_, &pool_, &metrics_, &trace_);
+    if (epIntrIn_) {
+        engine_->listen(*epIntrIn_, [this](const uint8_t* d, size_t n){ onInterrupt(d, n); });
+        std::lock_guard<std::mutex> lk(presMutex_);
+        listening_ = true;
+    }
 }
 
-void Acr38Usb::releaseIf(){
-    if (h_ && ifNum_>=0) {
-        libusb_release_interface(h_, ifNum_);
+void Acr38Usb::finishClose(libusb_device_handle* h, int ifNum){
+    io_->setHandle(nullptr);
+    pool_.clear();
+    if (h) {
+        if (ifNum>=0) libusb_release_interface(h, ifNum);
+        libusb_close(h);
     }
+    std::lock_guard<std::mutex> lk(closeMutex_);
+    closing_ = false;
+    closeCv_.notify_all();
 }
 
-std::vector<uint8_t> Acr38Usb::ccidSend(uint8_t msgType,
-                                        const std::vector<uint8_t>& data,
-                                        uint8_t slot,
-                                        unsigned timeoutMs)
-{
+void Acr38Usb::waitClosed(){
+    if (engine_->onEventThread()) return;
+    std::unique_lock<std::mutex> lk(closeMutex_);
+    closeCv_.wait(lk, [this]{ return !closing_; });
+}
 
-    std::vector<uint8_t> out(10 + data.size());
+Frame Acr38Usb::ccidFrame(uint8_t msgType,
+                          const uint8_t* data, size_t n,
+                          uint8_t slot, uint16_t wLevel, uint8_t bParam)
+{
+    Frame out = pool_.acquire(10 + n);
+    out.resize(10 + n);
     out[0] = msgType;
-    const uint32_t L = (uint32_t)data.size();
+    const uint32_t L = (uint32_t)n;
     out[1] = (uint8_t)(L & 0xFF);
     out[2] = (uint8_t)((L>>8)&0xFF);
     out[3] = (uint8_t)((L>>16)&0xFF);
     out[4] = (uint8_t)((L>>24)&0xFF);
     out[5] = slot;
     out[6] = (uint8_t)(ccidSeq_++);
-    out[7] = out[8] = out[9] = 0;
-    if (!data.empty()) std::memcpy(out.data()+10, data.data(), data.size());
-
-    int tr=0;
-    int r = libusb_bulk_transfer(h_, epBulkOut_, out.data(), (int)out.size(), &tr, (int)timeoutMs);
-    if (r!=0 || tr!=(int)out.size()) throw ReaderError(std::string("CCID: ошибка передачи Bulk OUT: ") + libusbErr(r));
-
-    std::vector<uint8_t> buf; buf.reserve(1024);
-    auto read_chunk = [&](int to)->int{
-        uint8_t tmp[256]; int got=0;
-        int rr = libusb_bulk_transfer(h_, epBulkIn_, tmp, (int)sizeof(tmp), &got, to);
-        if (rr==LIBUSB_ERROR_TIMEOUT) return 0;
-        if (rr!=0) throw ReaderError(std::string("CCID: ошибка приёма Bulk IN: ") + libusbErr(rr));
-        buf.insert(buf.end(), tmp, tmp+got);
-        return got;
-    };
-    for (int i=0; i<5 && buf.size()<10; ++i) read_chunk((int)timeoutMs);
-    if (buf.size()<10) throw ReaderError("CCID: отсутствует/неполный заголовок");
-    const uint32_t dwLen = le32(&buf[1]);
-    const size_t need = 10u + (size_t)dwLen;
-    while (buf.size()<need) {
-        if (read_chunk((int)timeoutMs)==0) break;
-    }
-    if (buf.size()<need) throw ReaderError("CCID: не полный ответ");
-    return buf;
+    out[7] = bParam;
+    out[8] = (uint8_t)(wLevel & 0xFF);
+    out[9] = (uint8_t)(wLevel >> 8);
+    if (n) std::memcpy(out.data()+10, data, n);
+    return out;
 }
 
-std::vector<uint8_t> Acr38Usb::acsSend(uint8_t ins,
-                                       const std::vector<uint8_t>& data,
-                                       unsigned timeoutMs)
+Frame Acr38Usb::acsFrame(uint8_t ins, const uint8_t* data, size_t n){
+    const uint16_t N = (uint16_t)n;
+    Frame out = pool_.acquire(4 + n);
+    out.resize(4 + n);
+    out[0] = ACS_HDR;
+    out[1] = ins;
+    out[2] = uint8_t((N>>8)&0xFF);
+    out[3] = uint8_t(N & 0xFF);
+    if (n) std::memcpy(out.data()+4, data, n);
+    return out;
+}
+
+Frame Acr38Usb::ccidSend(uint8_t msgType,
+                         const std::vector<uint8_t>& data,
+                         uint8_t slot,
+                         unsigned timeoutMs,
+                         uint8_t bParam)
 {
+    UsbExchange ex{Framing::CCID, ccidFrame(msgType, data.data(), data.size(), slot, 0, bParam), timeoutMs, {}, {}};
+    return engine_->run(std::move(ex));
+}
 
-    const uint16_t N = (uint16_t)data.size();
-    std::vector<uint8_t> out; out.reserve(4+N);
-    out.push_back(ACS_HDR);
-    out.push_back(ins);
-    out.push_back(uint8_t((N>>8)&0xFF));
-    out.push_back(uint8_t(N & 0xFF));
-    out.insert(out.end(), data.begin(), data.end());
-
-    int tr=0;
-    int r = libusb_bulk_transfer(h_, epBulkOut_, out.data(), (int)out.size(), &tr, (int)timeoutMs);
-    if (r!=0 || tr!=(int)out.size()) throw ReaderError(std::string("ACS: ошибка передачи Bulk OUT: ") + libusbErr(r));
-
-    std::vector<uint8_t> buf; buf.reserve(512);
-    auto read_chunk = [&](int to)->int{
-        uint8_t tmp[256]; int got=0;
-        int rr = libusb_bulk_transfer(h_, epBulkIn_, tmp, (int)sizeof(tmp), &got, to);
-        if (rr==LIBUSB_ERROR_TIMEOUT) return 0;
-        if (rr!=0) throw ReaderError(std::string("ACS: ошибка приёма Bulk IN: ") + libusbErr(rr));
-        buf.insert(buf.end(), tmp, tmp+got);
-        return got;
-    };
-    for (int i=0;i<5 && buf.size()<4;++i) read_chunk((int)timeoutMs);
-    if (buf.size()<4 || buf[0]!=ACS_HDR) throw ReaderError("ACS: отсутствует/неполный заголовок");
-    const uint8_t status = buf[1];
-    const uint16_t len = (uint16_t(buf[2])<<8) | buf[3];
-    while (buf.size() < size_t(4+len)) {
-        if (read_chunk((int)timeoutMs)==0) break;
+Frame Acr38Usb::acsSend(uint8_t ins,
+                        const std::vector<uint8_t>& data,
+                        unsigned timeoutMs)
+{
+    UsbExchange ex{Framing::ACS, acsFrame(ins, data.data(), data.size()), timeoutMs, {}, {}};
+    auto r = engine_->run(std::move(ex));
+    if (r[0]!=ACS_HDR) throw ReaderError("ACS: отсутствует/неполный заголовок");
+    return r;
+}
+
+void Acr38Usb::checkCcidStatus(const Frame& r){
+    if ((r[7] & 0xC0) == 0x40) {
+        std::ostringstream os;
+        os<<"CCID: команда завершилась ошибкой, bStatus=0x"<<std::hex<<std::setfill('0')
+          <<std::setw(2)<<int(r[7])<<" bError=0x"<<std::setw(2)<<int(r[8]);
+        throw ReaderError(os.str());
     }
-    if (buf.size() < size_t(4+len)) throw ReaderError("ACS: неполный ответ устройства");
+}
 
-    std::vector<uint8_t> resp; resp.reserve(4+len);
-    resp.push_back(ACS_HDR); resp.push_back(status);
-    resp.push_back((uint8_t)((len>>8)&0xFF)); resp.push_back((uint8_t)(len&0xFF));
-    resp.insert(resp.end(), buf.begin()+4, buf.begin()+4+len);
-    return resp;
+void Acr38Usb::acsData(const Frame& r, std::vector<uint8_t>& out){
+    if (r[0]!=ACS_HDR) throw ReaderError("ACS: отсутствует/неполный заголовок");
+    if (r[1]!=0x00) throw ReaderError("ACS: обмен по T=0 завершился ошибкой");
+    const uint16_t L = (uint16_t(r[2])<<8) | r[3];
+    out.insert(out.end(), r.begin()+4, r.begin()+4+L);
 }
 
 CardPresence Acr38Usb::cardStatus(){
     if (!h_) throw ReaderError("Ридер не открыт");
+    {
+        std::lock_guard<std::mutex> lk(presMutex_);
+        if (listening_ && presenceValid_)
+            return !cardIn_ ? CardPresence::NotPresent
+                 : powered_ ? CardPresence::PresentActive : CardPresence::PresentInactive;
+    }
+    CardPresence st = CardPresence::Unknown;
     if (backend_ == Backend::CCID) {
         auto r = ccidSend(PC_to_RDR_GetSlotStatus, {});
         uint8_t bStatus = r[7] & 0x03;
-        if      (bStatus==0) return CardPresence::PresentActive;
-        else if (bStatus==1) return CardPresence::PresentInactive;
-        else if (bStatus==2) return CardPresence::NotPresent;
-        else return CardPresence::Unknown;
+        if      (bStatus==0) st = CardPresence::PresentActive;
+        else if (bStatus==1) st = CardPresence::PresentInactive;
+        else if (bStatus==2) st = CardPresence::NotPresent;
     } else {
         auto r = acsSend(ACS_GET_ACR_STAT, {});
-        uint8_t status = r[1]; (void)status;
         if (r.size()<5) throw ReaderError("ACS STAT: неправильный");
-        uint8_t cstat = r.back();
-        if      (cstat==0x00) return CardPresence::NotPresent;
-        else if (cstat==0x01) return CardPresence::PresentInactive;
-        else if (cstat==0x03) return CardPresence::PresentActive;
-        else return CardPresence::Unknown;
+        uint8_t cstat = r[r.size()-1];
+        if      (cstat==0x00) st = CardPresence::NotPresent;
+        else if (cstat==0x01) st = CardPresence::PresentInactive;
+        else if (cstat==0x03) st = CardPresence::PresentActive;
     }
+    if (st != CardPresence::Unknown) {
+        std::lock_guard<std::mutex> lk(presMutex_);
+        cardIn_ = st != CardPresence::NotPresent;
+        powered_ = st == CardPresence::PresentActive;
+        presenceValid_ = listening_;
+    }
+    return st;
 }
 
-std::vector<uint8_t> Acr38Usb::powerOn(){
-    if (!h_) throw ReaderError("Закрытый");
+void Acr38Usb::setPowered(bool on){
+    std::lock_guard<std::mutex> lk(presMutex_);
+    powered_ = on;
+    if (on) cardIn_ = true;
+}
+
+// NotifySlotChange: по два бита на слот (0 — карта есть, 1 — состояние менялось).
+// Формат уведомлений ACS не документирован: любое из них лишь сбрасывает кэш.
+void Acr38Usb::onInterrupt(const uint8_t* data, size_t n){
+    CardEventCallback cb;
+    std::vector<std::pair<unsigned, CardPresence>> events;
+    {
+        std::lock_guard<std::mutex> lk(presMutex_);
+        if (!data) {
+            // слушатель остановлен: дальше cardStatus() опрашивает ридер
+            listening_ = presenceValid_ = false;
+            ++cardEvents_;
+            presCv_.notify_all();
+            return;
+        }
+        if (backend_ == Backend::CCID && data[0] == RDR_to_PC_NotifySlotChange) {
+            const unsigned slots = (unsigned)std::min<size_t>((n - 1) * 4, ccidDesc_.maxSlotIndex + 1u);
+            for (unsigned slot = 0; slot < slots; ++slot) {
+                const uint8_t bits = (data[1 + slot/4] >> ((slot%4)*2)) & 0x03;
+                const bool in = bits & 0x01;
+                if (slot == 0) {
+                    if (!(bits & 0x02) && presenceValid_ && cardIn_ == in) continue;
+                    if (!in || (bits & 0x02)) powered_ = false;   // новая карта не активирована
+                    cardIn_ = in;
+                    presenceValid_ = true;
+                    events.emplace_back(0u, !in ? CardPresence::NotPresent
+                                             : powered_ ? CardPresence::PresentActive : CardPresence::PresentInactive);
+                } else if (bits & 0x02) {
+                    events.emplace_back(slot, in ? CardPresence::PresentInactive : CardPresence::NotPresent);
+                }
+            }
+        } else if (backend_ == Backend::ACS) {
+            presenceValid_ = false;
+            events.emplace_back(0u, CardPresence::Unknown);
+        }
+        if (events.empty()) return;
+        ++cardEvents_;
+        cb = cardCb_;
+        presCv_.notify_all();
+    }
+    if (cb) for (auto& e : events) cb(e.first, e.second);
+}
+
+void Acr38Usb::setCardEventCallback(CardEventCallback cb){
+    std::lock_guard<std::mutex> lk(presMutex_);
+    cardCb_ = std::move(cb);
+}
+
+// IccPowerOn / ACS RESET: для неактивной карты — холодный сброс, для активной — тёплый.
+std::vector<uint8_t> Acr38Usb::activate(){
+    std::vector<uint8_t> atr;
     if (backend_ == Backend::CCID) {
         auto r = ccidSend(PC_to_RDR_IccPowerOn, {});
+        checkCcidStatus(r);
         const uint32_t L = le32(&r[1]);
-        std::vector<uint8_t> atr(r.begin()+10, r.begin()+10+L);
-        return atr;
+        atr.assign(r.begin()+10, r.begin()+10+L);
     } else {
         auto r = acsSend(ACS_RESET_DEFAULT, {});
         if (r[1]!=0x00) throw ReaderError("ACS: сброс карты (RESET) завершился ошибкой");
         const uint16_t L = (uint16_t(r[2])<<8) | r[3];
-        std::vector<uint8_t> atr(r.begin()+4, r.begin()+4+L);
-        return atr;
+        atr.assign(r.begin()+4, r.begin()+4+L);
+    }
+    atr_ = atr;
+    atrInfo_ = parseAtr(atr_);
+    activeProto_ = chooseProtocol(atrInfo_);
+    activeFiDi_ = 0x11;
+    t1_.reset(atrInfo_);
+    setPowered(true);
+    std::lock_guard<std::mutex> lk(presMutex_);
+    atrEvents_ = cardEvents_;
+    return atr;
+}
+
+std::vector<uint8_t> Acr38Usb::powerOn(ResetMode mode){
+    if (!h_) throw ReaderError("Закрытый");
+    const auto started = ReaderMetrics::Clock::now();
+    if (mode == ResetMode::Reuse && reuseSession()) {
+        if (recorder_)
+            recorder_->atr(std::chrono::duration_cast<std::chrono::microseconds>(ReaderMetrics::Clock::now() - started).count(), atr_);
+        return atr_;
+    }
+    if (mode == ResetMode::Cold && cardStatus() == CardPresence::PresentActive) {
+        setPowered(false);
+        if (backend_ == Backend::CCID) (void)ccidSend(PC_to_RDR_IccPowerOff, {});
+        else (void)acsSend(ACS_POWER_OFF, {});
+    }
+    activate();
+    if (atrInfo_.valid) negotiate(autoPps_);
+    if (hostT1()) {
+        std::lock_guard<std::mutex> lk(t1Mutex_);
+        t1_.negotiateIfsd(t1Io(ioTimeoutMs_), hostIfsd());
+    }
+    saveSession();
+    if (recorder_)
+        recorder_->atr(std::chrono::duration_cast<std::chrono::microseconds>(ReaderMetrics::Clock::now() - started).count(), atr_);
+    return atr_;
+}
+
+// IFSD ограничен буфером ридера: блок целиком должен влезть в одно сообщение
+uint8_t Acr38Usb::hostIfsd() const {
+    size_t ifsd = std::min(T1_MAX_IFSD, maxMessage() - 10 - 5);
+    if (backend_ == Backend::CCID && ccidDesc_.maxIfsd) ifsd = std::min<size_t>(ifsd, ccidDesc_.maxIfsd);
+    return (uint8_t)ifsd;
+}
+
+// Текущая сессия годится, если карта активна и событий слота после ATR не было.
+// После open() (другой процесс) ATR и параметры берутся из файла сессии ридера:
+// карта, вынутая и вставленная заново, активной не бывает.
+bool Acr38Usb::reuseSession(){
+    if (atr_.empty()) {
+        std::ifstream in(sessionCachePath());
+        std::string magic, hex;
+        int proto = -1;
+        unsigned fidi = 0x11;
+        if (!(in >> magic >> hex >> proto >> std::hex >> fidi) || magic != "SMARTIO-ATR" || proto < 0 || proto > 1)
+            return false;
+        std::vector<uint8_t> atr;
+        try { atr = sessionBytes(hex); } catch (const std::exception&) { return false; }
+        if (atr.empty() || cardStatus() != CardPresence::PresentActive) return false;
+        atr_ = atr;
+        atrInfo_ = parseAtr(atr_);
+        activeProto_ = proto;
+        activeFiDi_ = (uint8_t)fidi;
+        t1_.reset(atrInfo_);
+        {
+            std::lock_guard<std::mutex> lk(presMutex_);
+            atrEvents_ = cardEvents_;
+        }
+        if (hostT1()) {
+            std::lock_guard<std::mutex> lk(t1Mutex_);
+            t1_.resync(t1Io(ioTimeoutMs_));
+            t1_.negotiateIfsd(t1Io(ioTimeoutMs_), hostIfsd());
+        }
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lk(presMutex_);
+        if (atrEvents_ != cardEvents_) return false;
     }
+    return cardStatus() == CardPresence::PresentActive;
+}
+
+// $XDG_RUNTIME_DIR/smartio-<vid><pid>-<путь>.atr: ATR, протокол и Fi/Di активной карты.
+std::string Acr38Usb::sessionCachePath() const {
+    const char* dir = std::getenv("XDG_RUNTIME_DIR");
+    char name[32];
+    std::snprintf(name, sizeof(name), "/smartio-%04x%04x-", loc_.vid, loc_.pid);
+    return std::string(dir && *dir ? dir : "/tmp") + name + readerPath(loc_) + ".atr";
+}
+
+void Acr38Usb::saveSession() const {
+    std::ofstream out(sessionCachePath(), std::ios::trunc);
+    if (out) out << "SMARTIO-ATR " << sessionHex(atr_.data(), atr_.size()) << ' ' << activeProto_
+                 << ' ' << std::hex << int(activeFiDi_) << '\n';
+}
+
+uint8_t Acr38Usb::chooseProtocol(const AtrInfo& a) const {
+    if (iso_ == IsoProtocol::T0) return 0;
+    if (iso_ == IsoProtocol::T1) return 1;
+    return a.protocol <= 1 ? a.protocol : 0;
+}
+
+// Наибольшая скорость, общая для карты (TA1) и ридера: Fi карты, D — не выше
+// объявленного картой и в пределах dwMaxDataRate/OpenParams::maxBaud.
+uint8_t Acr38Usb::chooseFiDi(const AtrInfo& a, unsigned clockKHz, unsigned maxRate) const {
+    const unsigned F = atrF(a.fi);
+    if (!a.ta1 || !F || !atrD(a.di)) return 0x11;
+    uint8_t best = 0x11;
+    uint64_t bestRate = (uint64_t)clockKHz*1000/372;
+    for (uint8_t di=1; di<=9; ++di){
+        const unsigned D = atrD(di);
+        if (!D || D > atrD(a.di)) continue;
+        const uint64_t rate = (uint64_t)clockKHz*1000*D/F;
+        if (maxRate && rate > maxRate) continue;
+        if (rate > bestRate) { best = uint8_t((a.fi<<4) | di); bestRate = rate; }
+    }
+    return best;
+}
+
+// Согласование протокола и скорости после ATR. Отказ карты не фатален:
+// карта перезапускается и остаётся на параметрах по умолчанию.
+// speed=false (OpenParams::autoPps выключен): без PPS, Fi/Di по умолчанию,
+// но протокол ридеру всё равно задаётся SetParameters.
+void Acr38Usb::negotiate(bool speed){
+    const uint8_t proto = (uint8_t)activeProto_;
+    if (backend_ == Backend::CCID) {
+        const uint32_t f = ccidDesc_.features;
+        // ридер согласует сам: фактические параметры — от него
+        if (f & (FEAT_AUTO_ATR | FEAT_AUTO_NEGO)) { readParameters(); return; }
+        if (!speed) {
+            const uint8_t fidi = atrInfo_.specificMode && atrInfo_.ta1 ? *atrInfo_.ta1 : 0x11;
+            if (fidi == 0x11 && proto == 0) return;
+            setParameters(proto, fidi);
+            activeFiDi_ = fidi;
+            return;
+        }
+        unsigned maxRate = ccidDesc_.maxDataRate;
+        if (maxBaud_ && (!maxRate || maxBaud_ < maxRate)) maxRate = maxBaud_;
+        const unsigned clk = ccidDesc_.defaultClockKHz ? ccidDesc_.defaultClockKHz : ACS_CLOCK_KHZ;
+        uint8_t fidi = atrInfo_.specificMode ? (atrInfo_.ta1 ? *atrInfo_.ta1 : 0x11)
+                                             : chooseFiDi(atrInfo_, clk, maxRate);
+        if (fidi == 0x11 && proto == 0) return;
+
+        // без автоматического PPS ридера PPS уходит картой через XfrBlock (только TPDU)
+        if (!atrInfo_.specificMode && !(f & FEAT_AUTO_PPS)) {
+            if (level_ != ExchangeLevel::Tpdu) fidi = 0x11;
+            else if (!ppsExchange(proto, fidi)) { activate(); fidi = 0x11; }
+        }
+        try {
+            setParameters(proto, fidi);
+        } catch (const ReaderError&) {
+            if (fidi == 0x11) throw;
+            activate();
+            setParameters(proto, 0x11);
+            fidi = 0x11;
+        }
+        activeFiDi_ = fidi;
+    } else {
+        if (!speed) return;     // у ACS протокол задаётся самим обменом (EXCHANGE_T0/T1)
+        const uint8_t fidi = atrInfo_.specificMode ? 0x11 : chooseFiDi(atrInfo_, ACS_CLOCK_KHZ, maxBaud_);
+        if (fidi == 0x11 && proto == 0) return;
+        if (!ppsExchange(proto, fidi)) { activate(); return; }
+        activeFiDi_ = fidi;
+    }
+}
+
+bool Acr38Usb::ppsExchange(uint8_t proto, uint8_t fidi){
+    std::vector<uint8_t> pps = {0xFF, uint8_t(0x10 | proto), fidi, 0};
+    pps[3] = pps[0] ^ pps[1] ^ pps[2];
+    try {
+        if (backend_ == Backend::CCID) {
+            auto r = ccidSend(PC_to_RDR_XfrBlock, pps, 0, ioTimeoutMs_);
+            checkCcidStatus(r);
+            // ответ карты должен повторить PPS0/PPS1
+            return le32(&r[1]) >= 3 && r[10+1] == pps[1] && r[10+2] == pps[2];
+        }
+        auto r = acsSend(ACS_SET_CARD_PPS, pps, ioTimeoutMs_);
+        return r[1] == 0x00;
+    } catch (const ReaderError&) {
+        return false;
+    }
+}
+
+// RDR_to_PC_Parameters: bProtocolNum, abProtocolData[0] = bmFindexDindex.
+void Acr38Usb::readParameters(){
+    try {
+        auto r = ccidSend(PC_to_RDR_GetParameters, {}, 0, ioTimeoutMs_);
+        checkCcidStatus(r);
+        if (r[9] <= 1) activeProto_ = r[9];
+        if (le32(&r[1]) >= 1) activeFiDi_ = r[10];
+    } catch (const ReaderError&) {}     // без GetParameters остаются значения по ATR
+}
+
+void Acr38Usb::setParameters(uint8_t proto, uint8_t fidi){
+    const AtrInfo& a = atrInfo_;
+    const uint8_t guard = a.tc1 ? *a.tc1 : 0x00;
+    std::vector<uint8_t> d;
+    if (proto == 0)
+        d = {fidi, uint8_t(a.inverse ? 0x02 : 0x00), guard, a.wi, 0x00};
+    else
+        d = {fidi, uint8_t(0x10 | (a.inverse ? 0x02 : 0x00) | (a.crc ? 0x01 : 0x00)), guard,
+             uint8_t((a.bwi<<4) | a.cwi), 0x00, a.ifsc, 0x00};
+    checkCcidStatus(ccidSend(PC_to_RDR_SetParameters, d, 0, ioTimeoutMs_, proto));
 }
 
 void Acr38Usb::powerOff(){
     if (!h_) throw ReaderError("Закрытый");
+    atr_.clear(); atrInfo_ = {}; activeProto_ = -1; activeFiDi_ = 0x11;
+    setPowered(false);
+    std::remove(sessionCachePath().c_str());
+    if (recorder_) recorder_->off();
     if (backend_ == Backend::CCID) {
         (void)ccidSend(PC_to_RDR_IccPowerOff, {});
     } else {
@@ -261,6 +729,14 @@ void Acr38Usb::powerOff(){
 
 bool Acr38Usb::waitCardEvent(unsigned timeoutMs){
     if (!h_) throw ReaderError("Закрытый");
+    {
+        std::unique_lock<std::mutex> lk(presMutex_);
+        if (listening_) {
+            const uint64_t seen = cardEvents_;
+            return presCv_.wait_for(lk, std::chrono::milliseconds(timeoutMs),
+                                    [&]{ return cardEvents_ != seen; });
+        }
+    }
     if (!epIntrIn_) {
         (void)timeoutMs;
         return false;
@@ -272,22 +748,372 @@ bool Acr38Usb::waitCardEvent(unsigned timeoutMs){
     return got>0;
 }
 
-XfrResult Acr38Usb::transmit(const std::vector<uint8_t>& capdu, unsigned timeoutMs){
-    if (!h_) throw ReaderError("Закрытый");
-    if (backend_ == Backend::CCID) {
-        auto r = ccidSend(PC_to_RDR_XfrBlock, capdu, 0, timeoutMs);
-        const uint32_t L = le32(&r[1]);
-        XfrResult xr;
-        xr.data.assign(r.begin()+10, r.begin()+10+L);
-        return xr;
+// Один APDU поверх XfrBlock с цепочками CCID (wLevelParameter / bChainParameter):
+// команда длиннее сообщения ридера уходит блоками 01/03/02, продолжение ответа
+// запрашивается пустым XfrBlock с wLevelParameter=0010.
+struct Acr38Usb::XfrJob {
+    std::vector<uint8_t> capdu;
+    size_t off = 0;
+    bool cmdDone = false;
+    XfrResult xr;
+    XfrCallback done;
+    unsigned timeoutMs = 2000;
+    bool autoResp = false;      // 61xx/6Cxx: следующий раунд без возврата вызывающему
+    bool held = false;          // ответ придержал очередь движка
+    bool keep = false;          // пакет: очередь держится и после окончательного ответа
+    ReaderMetrics::Clock::time_point started;
+    std::vector<uint8_t> original;  // команда до раундов T=0, для записи сессии
+    int rounds = 0;
+    size_t roundStart = 0;      // начало данных текущего раунда в xr.data
+};
+
+// Следующий раунд T=0 в job.capdu: GET RESPONSE на 61xx, повтор той же команды
+// с Le=xx на 6Cxx. Данные копятся в одном буфере xr.data; false — ответ окончательный.
+bool Acr38Usb::nextT0Round(XfrJob& job){
+    auto& d = job.xr.data;
+    if (!job.autoResp || job.rounds >= MAX_T0_ROUNDS || d.size() < job.roundStart + 2) return false;
+    const uint8_t sw1 = d[d.size()-2], sw2 = d[d.size()-1];
+    if (sw1 == 0x61) {
+        d.resize(d.size() - 2);
+        const uint8_t cla = job.capdu[0] & 0x80 ? 0x00 : job.capdu[0] & 0x03;   // логический канал
+        job.capdu = {cla, 0xC0, 0x00, 0x00, sw2};
+    } else if (sw1 == 0x6C && job.capdu.size() == 5) {
+        d.resize(job.roundStart);
+        job.capdu[4] = sw2;
+        metrics_.retries.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        return false;
+    }
+    ++job.rounds;
+    job.roundStart = d.size();
+    job.off = 0;
+    job.cmdDone = false;
+    return true;
+}
+
+void Acr38Usb::xfrStep(const std::shared_ptr<XfrJob>& job, bool front){
+    const size_t maxData = maxMessage() - 10;
+    UsbExchange ex;
+    ex.framing = Framing::CCID;
+    ex.timeoutMs = job->timeoutMs;
+    if (!job->cmdDone) {
+        const size_t n = std::min(maxData, job->capdu.size() - job->off);
+        const bool first = job->off == 0, last = job->off + n == job->capdu.size();
+        const uint16_t w = (first && last) ? CHAIN_NONE : first ? CHAIN_BEGIN : last ? CHAIN_END : CHAIN_MIDDLE;
+        ex.out = ccidFrame(PC_to_RDR_XfrBlock, job->capdu.data() + job->off, n, 0, w);
+        job->off += n;
+        job->cmdDone = last;
     } else {
-        auto r = acsSend(ACS_EXCHANGE_T0, capdu, timeoutMs);
-        if (r[1]!=0x00) throw ReaderError("ACS: обмен по T=0 завершился ошибкой");
+        ex.out = ccidFrame(PC_to_RDR_XfrBlock, nullptr, 0, 0, CHAIN_CONTINUE);
+    }
+    ex.hold = [job](const Frame& r){
+        if (r[9]==CHAIN_BEGIN || r[9]==CHAIN_MIDDLE || r[9]==CHAIN_CONTINUE) return true;
+        job->held = job->cmdDone && r[0]==RDR_to_PC_DataBlock
+                 && (job->keep || (job->autoResp && t0Pending(r.data()+10, std::min<size_t>(le32(&r[1]), r.size()-10))));
+        return job->held;
+    };
+    ex.done = [this, job](Frame&& r, std::exception_ptr err){
+        if (!err) {
+            try {
+                checkCcidStatus(r);
+                if (!job->cmdDone) { xfrStep(job, true); return; }
+                const uint32_t L = le32(&r[1]);
+                job->xr.data.insert(job->xr.data.end(), r.begin()+10, r.begin()+10+L);
+                if (r[9]==CHAIN_BEGIN || r[9]==CHAIN_MIDDLE) { xfrStep(job, true); return; }
+                if (nextT0Round(*job)) { job->held = false; xfrStep(job, true); return; }
+            } catch (...) {
+                err = std::current_exception();
+                job->held = false;
+                engine_->release();
+            }
+        }
+        if (job->held && !job->keep) { job->held = false; engine_->release(); }
+        finishApdu(job->started, job->original.data(), job->original.size(),
+                   job->xr.data.data(), job->xr.data.size(), !err);
+        if (job->done) job->done(std::move(job->xr), err);
+    };
+    engine_->submit(std::move(ex), front);
+}
+
+// T=1 ведёт хост, если ридер передаёт TPDU как есть (CCID уровня TPDU, ACS).
+bool Acr38Usb::hostT1() const {
+    return activeProto_ == 1 && (backend_ == Backend::ACS || level_ == ExchangeLevel::Tpdu);
+}
+
+T1Protocol::BlockIo Acr38Usb::t1Io(unsigned timeoutMs){
+    return [this, timeoutMs](const std::vector<uint8_t>& b, uint8_t wtx) -> std::vector<uint8_t> {
+        const unsigned t = timeoutMs * (wtx ? wtx : 1);
+        if (backend_ == Backend::CCID) {
+            // bBWI: множитель BWT на время обмена, запрошенный картой через S(WTX)
+            auto r = ccidSend(PC_to_RDR_XfrBlock, b, 0, t, wtx);
+            checkCcidStatus(r);
+            const uint32_t L = le32(&r[1]);
+            return std::vector<uint8_t>(r.begin()+10, r.begin()+10+L);
+        }
+        auto r = acsSend(ACS_EXCHANGE_T1, b, t);
+        if (r[1]!=0x00) throw ReaderError("ACS: обмен по T=1 завершился ошибкой");
         const uint16_t L = (uint16_t(r[2])<<8) | r[3];
-        XfrResult xr;
-        xr.data.assign(r.begin()+4, r.begin()+4+L);
-        return xr;
+        return std::vector<uint8_t>(r.begin()+4, r.begin()+4+L);
+    };
+}
+
+XfrResult Acr38Usb::transmitT1(const std::vector<uint8_t>& capdu, unsigned timeoutMs){
+    std::lock_guard<std::mutex> lk(t1Mutex_);
+    if (!h_) throw ReaderError("Закрытый");
+    const auto started = ReaderMetrics::Clock::now();
+    XfrResult xr;
+    xr.data = t1_.transceive(t1Io(timeoutMs), capdu);
+    finishApdu(started, capdu.data(), capdu.size(), xr.data.data(), xr.data.size());
+    return xr;
+}
+
+XfrResult Acr38Usb::transmit(const std::vector<uint8_t>& capdu, unsigned timeoutMs){
+    if (!h_) throw ReaderError("Закрытый");
+    if (engine_->onEventThread())
+        throw ReaderError("Синхронный transmit из потока событий USB невозможен");
+    if (hostT1()) return transmitT1(capdu, timeoutMs);
+    return transmitAsync(capdu, timeoutMs).get();
+}
+
+void Acr38Usb::transmitAsync(const std::vector<uint8_t>& capdu, XfrCallback done, unsigned timeoutMs){
+    if (!h_) throw ReaderError("Закрытый");
+    if (hostT1()) {
+        // блоки T=1 идут синхронно, поэтому обмен уходит в отдельный поток
+        t1Queue_.post([this, capdu, done = std::move(done), timeoutMs]{
+            XfrResult xr;
+            std::exception_ptr err;
+            try { xr = transmitT1(capdu, timeoutMs); }
+            catch (...) { err = std::current_exception(); }
+            if (done) done(std::move(xr), err);
+        });
+        return;
+    }
+    auto job = std::make_shared<XfrJob>();
+    job->capdu = capdu;
+    job->done = std::move(done);
+    job->timeoutMs = timeoutMs;
+    // ответ всех раундов собирается в одном буфере
+    job->xr.data.reserve(autoGetResponse_ ? maxMessage() : 258);
+    startJob(job, false);
+}
+
+// Быстрый путь для одного сообщения: кадр из пула, ожидание на стеке, ответ
+// копируется сразу в буфер вызывающего. Раунды 61xx/6Cxx (autoGetResponse) идут
+// в том же буфере, очередь движка между ними придерживается. T=1 на стороне хоста
+// и команды длиннее сообщения ридера идут общим путём через transmit().
+size_t Acr38Usb::transmitInto(const uint8_t* capdu, size_t len, uint8_t* rapdu, size_t cap, unsigned timeoutMs){
+    if (!h_) throw ReaderError("Закрытый");
+    const size_t hdr = backend_==Backend::CCID ? 10 : 4;
+    if (hostT1() || hdr + len > maxMessage()) {
+        auto xr = transmit(std::vector<uint8_t>(capdu, capdu + len), timeoutMs);
+        if (xr.data.size() > cap) throw BufferTooSmall("Ответ длиннее буфера вызывающего");
+        std::memcpy(rapdu, xr.data.data(), xr.data.size());
+        return xr.data.size();
+    }
+    const auto started = ReaderMetrics::Clock::now();
+    const bool autoResp = autoGetResponse_ && activeProto_ != 1 && len >= 4;
+    bool held = false;      // ответ с 61xx/6Cxx придержал очередь до следующего раунда
+    const auto pending = [&](const uint8_t* d, size_t n){ return held = autoResp && t0Pending(d, n); };
+    // ответ может прийти цепочкой: продолжение запрашивается без отпускания очереди
+    const auto chained = [](const Frame& r){
+        return r[9]==CHAIN_BEGIN || r[9]==CHAIN_MIDDLE || r[9]==CHAIN_CONTINUE;
+    };
+
+    // один раунд: ответ пишется в rapdu с позиции at, возвращается новая длина
+    const auto round = [&](const uint8_t* c, size_t cl, size_t at, bool front) -> size_t {
+        if (backend_ == Backend::ACS) {
+            Frame r = engine_->run({Framing::ACS, acsFrame(ACS_EXCHANGE_T0, c, cl), timeoutMs, {},
+                [&](const Frame& f){
+                    const size_t L = (size_t(f[2])<<8) | f[3];
+                    return f[0]==ACS_HDR && f[1]==0x00 && pending(f.data()+4, std::min(L, f.size()-4));
+                }}, front);
+            if (r[0]!=ACS_HDR) throw ReaderError("ACS: отсутствует/неполный заголовок");
+            if (r[1]!=0x00) throw ReaderError("ACS: обмен по T=0 завершился ошибкой");
+            const size_t L = (size_t(r[2])<<8) | r[3];
+            if (at + L > cap) throw BufferTooSmall("Ответ длиннее буфера вызывающего");
+            std::memcpy(rapdu + at, r.data()+4, L);
+            return at + L;
+        }
+        const auto hold = [&](const Frame& f){
+            return chained(f) || (f[0]==RDR_to_PC_DataBlock
+                                  && pending(f.data()+10, std::min<size_t>(le32(&f[1]), f.size()-10)));
+        };
+        Frame r = engine_->run({Framing::CCID, ccidFrame(PC_to_RDR_XfrBlock, c, cl, 0), timeoutMs, {}, hold}, front);
+        size_t n = at;
+        while (true) {
+            const bool more = r[9]==CHAIN_BEGIN || r[9]==CHAIN_MIDDLE;
+            const size_t L = le32(&r[1]);
+            try {
+                if (chained(r) && !more) throw ReaderError("CCID: неожиданный bChainParameter в ответе");
+                checkCcidStatus(r);
+                if (n + L > cap) throw BufferTooSmall("Ответ длиннее буфера вызывающего");
+            } catch (...) {
+                if (chained(r)) engine_->release();
+                throw;
+            }
+            std::memcpy(rapdu + n, r.data()+10, L);
+            n += L;
+            if (!more) return n;
+            r = engine_->run({Framing::CCID, ccidFrame(PC_to_RDR_XfrBlock, nullptr, 0, 0, CHAIN_CONTINUE), timeoutMs, {}, hold}, true);
+        }
+    };
+
+    try {
+        // 61xx — GET RESPONSE, данные дописываются поверх SW; 6Cxx — повтор с Le=xx поверх ответа
+        uint8_t next[5];
+        const uint8_t* c = capdu;
+        size_t cl = len, roundStart = 0;
+        size_t n = round(c, cl, 0, false);
+        for (int rounds = 0; held && rounds < MAX_T0_ROUNDS; ++rounds) {
+            const uint8_t sw1 = rapdu[n-2], sw2 = rapdu[n-1];
+            if (sw1 == 0x61) {
+                const uint8_t cla = c[0] & 0x80 ? 0x00 : c[0] & 0x03;   // логический канал
+                next[0] = cla; next[1] = 0xC0; next[2] = next[3] = 0x00; next[4] = sw2;
+                roundStart = n - 2;
+            } else if (sw1 == 0x6C && cl == 5) {
+                if (c != next) std::memcpy(next, c, 5);
+                next[4] = sw2;
+                metrics_.retries.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                break;
+            }
+            c = next; cl = 5;
+            n = round(c, cl, roundStart, true);
+        }
+        if (held) { held = false; engine_->release(); }
+        finishApdu(started, capdu, len, rapdu, n);
+        return n;
+    } catch (...) {
+        if (held) engine_->release();
+        throw;
+    }
+}
+
+void Acr38Usb::startJob(const std::shared_ptr<XfrJob>& job, bool front){
+    const bool canChain = backend_==Backend::CCID
+                       && (level_==ExchangeLevel::ShortApdu || level_==ExchangeLevel::ExtendedApdu);
+    const size_t hdr = backend_==Backend::CCID ? 10 : 4;
+    if (hdr + job->capdu.size() > maxMessage() && !canChain)
+        throw ReaderError("APDU длиннее максимального сообщения ридера");
+    job->off = 0;
+    job->cmdDone = job->held = false;
+    job->rounds = 0;
+    job->roundStart = 0;
+    job->autoResp = autoGetResponse_ && activeProto_ != 1 && job->capdu.size() >= 4;
+    job->started = ReaderMetrics::Clock::now();
+    if (recorder_) job->original = job->capdu;
+    if (backend_ == Backend::CCID) xfrStep(job, front);
+    else acsStep(job, front);
+}
+
+// Пакет идёт цепочкой: следующая команда ставится в голову очереди прямо из
+// завершения предыдущей, без возврата в вызывающий поток. Одно задание и один
+// буфер ответа на весь пакет.
+BatchResult Acr38Usb::transmitBatch(const ApduBatch& batch, unsigned timeoutMs){
+    if (!h_) throw ReaderError("Закрытый");
+    if (engine_->onEventThread())
+        throw ReaderError("Синхронный transmitBatch из потока событий USB невозможен");
+    struct State {
+        const ApduBatch* batch;
+        BatchResult res;
+        size_t next = 0;
+        std::promise<void> fin;
+    };
+    auto st = std::make_shared<State>();
+    st->batch = &batch;
+    st->res.offsets.reserve(batch.size());
+    st->res.data.reserve(batch.size() * 258);
+    if (!batch.size()) return std::move(st->res);
+
+    auto append = [](State& s, const std::vector<uint8_t>& r){
+        s.res.offsets.push_back(s.res.data.size());
+        s.res.data.insert(s.res.data.end(), r.begin(), r.end());
+        const size_t i = s.next++;
+        const bool ok = r.size()>=2 && r[r.size()-2]==0x90 && r[r.size()-1]==0x00;
+        return s.next < s.batch->size() && (ok || !s.batch->stopOnError[i]);
+    };
+
+    if (hostT1()) {
+        std::lock_guard<std::mutex> lk(t1Mutex_);
+        const auto io = t1Io(timeoutMs);
+        std::vector<uint8_t> c;
+        bool more = true;
+        while (more) {
+            c.assign(batch.apdu(st->next), batch.apdu(st->next) + batch.length(st->next));
+            const auto started = ReaderMetrics::Clock::now();
+            auto r = t1_.transceive(io, c);
+            finishApdu(started, c.data(), c.size(), r.data(), r.size());
+            more = append(*st, r);
+        }
+        return std::move(st->res);
     }
+
+    auto job = std::make_shared<XfrJob>();
+    job->timeoutMs = timeoutMs;
+    job->xr.data.reserve(258);
+    std::weak_ptr<XfrJob> weak = job;
+    job->done = [this, st, weak, append](XfrResult&& r, std::exception_ptr err){
+        auto job = weak.lock();
+        if (!err && job && append(*st, r.data)) {
+            r.data.clear();     // r — это job->xr: буфер ответа переиспользуется
+            const size_t i = st->next;
+            job->capdu.assign(st->batch->apdu(i), st->batch->apdu(i) + st->batch->length(i));
+            job->keep = i + 1 < st->batch->size();
+            try { startJob(job, true); return; }
+            catch (...) { err = std::current_exception(); }
+        }
+        if (job && job->held) { job->held = false; engine_->release(); }
+        if (err) st->fin.set_exception(err);
+        else st->fin.set_value();
+    };
+    job->capdu.assign(batch.apdu(0), batch.apdu(0) + batch.length(0));
+    job->keep = batch.size() > 1;
+    startJob(job, false);
+    st->fin.get_future().get();
+    return std::move(st->res);
+}
+
+void Acr38Usb::acsStep(const std::shared_ptr<XfrJob>& job, bool front){
+    UsbExchange ex;
+    ex.framing = Framing::ACS;
+    ex.timeoutMs = job->timeoutMs;
+    ex.out = acsFrame(ACS_EXCHANGE_T0, job->capdu.data(), job->capdu.size());
+    ex.hold = [job](const Frame& r){
+        const size_t L = (size_t(r[2])<<8) | r[3];
+        job->held = r[0]==ACS_HDR && r[1]==0x00
+                 && (job->keep || (job->autoResp && t0Pending(r.data()+4, std::min(L, r.size()-4))));
+        return job->held;
+    };
+    ex.done = [this, job](Frame&& r, std::exception_ptr err){
+        if (!err) {
+            try {
+                acsData(r, job->xr.data);
+                if (nextT0Round(*job)) { job->held = false; acsStep(job, true); return; }
+            } catch (...) { err = std::current_exception(); }
+        }
+        if (job->held && !job->keep) { job->held = false; engine_->release(); }
+        finishApdu(job->started, job->original.data(), job->original.size(),
+                   job->xr.data.data(), job->xr.data.size(), !err);
+        if (job->done) job->done(std::move(job->xr), err);
+    };
+    engine_->submit(std::move(ex), front);
+}
+
+// Конец APDU: гистограмма задержки и, если включена, запись в файл сессии.
+void Acr38Usb::finishApdu(ReaderMetrics::Clock::time_point started, const uint8_t* c, size_t cn,
+                          const uint8_t* r, size_t rn, bool ok){
+    metrics_.record(StatOp::Apdu, started);
+    if (!recorder_ || !ok) return;
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(ReaderMetrics::Clock::now() - started).count();
+    recorder_->xfr((uint64_t)us, c, cn, r, rn);
+}
+
+ReaderStats Acr38Usb::stats(bool reset){
+    return metrics_.snapshot(reset);
+}
+
+size_t Acr38Usb::dumpTrace(const std::string& pcapPath){
+    return trace_.dumpPcap(pcapPath);
 }
 
 std::vector<uint8_t> Acr38Usb::vendorControl(const std::vector<uint8_t>& payload){
@@ -3,11 +3,28 @@
 
 #pragma once
 #include "ReaderApi.h"
+#include "Atr.h"
+#include "SessionFile.h"
+#include "framepool.h"
+#include "libusbtransport.h"
+#include "usbcontext.h"
+#include "usbengine.h"
+#include "t1proto.h"
+#include "taskqueue.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <libusb-1.0/libusb.h>
 
 namespace smartio {
 
+// Ответ не помещается в буфер вызывающего (transmitInto).
+struct BufferTooSmall : ReaderError {
+    using ReaderError::ReaderError;
+};
+
 class Acr38Usb final : public ICardReader {
 public:
     Acr38Usb();
@@ -18,41 +35,129 @@ public:
     ReaderInfo info() const override;
 
     CardPresence cardStatus() override;
-    std::vector<uint8_t> powerOn() override;
+    std::vector<uint8_t> powerOn(ResetMode mode = ResetMode::Cold) override;
     void powerOff() override;
     bool waitCardEvent(unsigned timeoutMs) override;
+    void setCardEventCallback(CardEventCallback cb) override;
 
     XfrResult transmit(const std::vector<uint8_t>& capdu,
                        unsigned timeoutMs) override;
+    void transmitAsync(const std::vector<uint8_t>& capdu,
+                       XfrCallback done,
+                       unsigned timeoutMs) override;
+    using ICardReader::transmitAsync;
+    BatchResult transmitBatch(const ApduBatch& batch, unsigned timeoutMs) override;
+    size_t transmitInto(const uint8_t* capdu, size_t len, uint8_t* rapdu, size_t cap, unsigned timeoutMs);
 
     std::vector<uint8_t> vendorControl(const std::vector<uint8_t>& payload) override;
 
+    ReaderStats stats(bool reset) override;
+    size_t dumpTrace(const std::string& pcapPath) override;
+
+    static std::vector<ReaderLocation> enumerate(uint16_t vid, uint16_t pid);
+
 private:
-    libusb_context* ctx_ = nullptr;
+    std::shared_ptr<UsbContext> usb_;
     libusb_device_handle* h_ = nullptr;
     int ifNum_ = -1;
     uint8_t epBulkIn_ = 0, epBulkOut_ = 0;
+    uint16_t inMaxPacket_ = 64;
+    CcidDescriptor ccidDesc_;
+    ExchangeLevel level_ = ExchangeLevel::ShortApdu;
     std::optional<uint8_t> epIntrIn_;
     uint16_t vid_ = 0, pid_ = 0;
+    ReaderLocation loc_{};
 
     enum class Backend { CCID, ACS } backend_ = Backend::CCID;
     IsoProtocol iso_ = IsoProtocol::Auto;
 
     unsigned ioTimeoutMs_ = 2000;
-    uint32_t ccidSeq_ = 1;
+    bool autoPps_ = true;
+    unsigned maxBaud_ = 0;
+    bool autoGetResponse_ = false;
+
+    std::vector<uint8_t> atr_;
+    AtrInfo atrInfo_;
+    int activeProto_ = -1;
+    uint8_t activeFiDi_ = 0x11;
+    std::atomic<uint32_t> ccidSeq_{1};
+    FramePool pool_;
+    ReaderMetrics metrics_;
+    TraceRing trace_;
+    LibusbTransport* io_ = nullptr;     // принадлежит engine_
+    std::unique_ptr<UsbEngine> engine_;
+    T1Protocol t1_;
+    std::mutex t1Mutex_;
+    TaskQueue t1Queue_;
+    std::unique_ptr<SessionWriter> recorder_;
+
+    // close() из потока событий: дескриптор закрывается после отмены передач
+    std::mutex closeMutex_;
+    std::condition_variable closeCv_;
+    bool closing_ = false;
+
+    // состояние карты по NotifySlotChange; cardStatus() отвечает из кэша
+    std::mutex presMutex_;
+    std::condition_variable presCv_;
+    bool listening_ = false;
+    bool presenceValid_ = false;
+    bool cardIn_ = false, powered_ = false;
+    uint64_t cardEvents_ = 0;
+    uint64_t atrEvents_ = 0;        // cardEvents_ на момент получения atr_
+    CardEventCallback cardCb_;
 
     void findAndClaim(const OpenParams& p);
-    void releaseIf();
-
-    std::vector<uint8_t> ccidSend(uint8_t msgType,
-                                  const std::vector<uint8_t>& data,
-                                  uint8_t slot = 0,
-                                  unsigned timeoutMs = 2000);
-
-    std::vector<uint8_t> acsSend(uint8_t ins,
-                                 const std::vector<uint8_t>& data,
-                                 unsigned timeoutMs = 2000);
-
+    static bool parseLayout(const libusb_config_descriptor* cfg, int hint, InterfaceLayout& l);
+    void applyLayout(const InterfaceLayout& l);
+    static void readSerial(libusb_device_handle* h, const libusb_device_descriptor& t, ReaderLocation& l);
+    size_t maxMessage() const;
+    void finishClose(libusb_device_handle* h, int ifNum);
+    void waitClosed();
+
+    Frame ccidFrame(uint8_t msgType,
+                    const uint8_t* data, size_t n,
+                    uint8_t slot, uint16_t wLevel = 0, uint8_t bParam = 0);
+    Frame acsFrame(uint8_t ins, const uint8_t* data, size_t n);
+    static void checkCcidStatus(const Frame& r);
+    static void acsData(const Frame& r, std::vector<uint8_t>& out);
+
+    struct XfrJob;
+    void xfrStep(const std::shared_ptr<XfrJob>& job, bool front);
+    void acsStep(const std::shared_ptr<XfrJob>& job, bool front);
+    void startJob(const std::shared_ptr<XfrJob>& job, bool front);
+    bool nextT0Round(XfrJob& job);
+
+    Frame ccidSend(uint8_t msgType,
+                   const std::vector<uint8_t>& data,
+                   uint8_t slot = 0,
+                   unsigned timeoutMs = 2000,
+                   uint8_t bParam = 0);
+
+    Frame acsSend(uint8_t ins,
+                  const std::vector<uint8_t>& data,
+                  unsigned timeoutMs = 2000);
+
+
+    std::vector<uint8_t> activate();
+    bool reuseSession();
+    uint8_t hostIfsd() const;
+    std::string sessionCachePath() const;
+    void saveSession() const;
+    uint8_t chooseProtocol(const AtrInfo& a) const;
+    uint8_t chooseFiDi(const AtrInfo& a, unsigned clockKHz, unsigned maxRate) const;
+    void negotiate(bool speed);
+    void readParameters();
+    bool ppsExchange(uint8_t proto, uint8_t fidi);
+    void setParameters(uint8_t proto, uint8_t fidi);
+
+    bool hostT1() const;
+    T1Protocol::BlockIo t1Io(unsigned timeoutMs);
+    XfrResult transmitT1(const std::vector<uint8_t>& capdu, unsigned timeoutMs);
+    void finishApdu(ReaderMetrics::Clock::time_point started, const uint8_t* c, size_t cn,
+                    const uint8_t* r, size_t rn, bool ok = true);
+
+    void onInterrupt(const uint8_t* data, size_t n);
+    void setPowered(bool on);
 
     static std::string libusbErr(int r);
 };
@@ -1,8 +1,16 @@
 #include "ReaderApi.h"
 #include "acr38usb.h"
+#include <cstring>
 
 using namespace smartio;
 
+static thread_local char g_lastError[256];
+
+static int fail(int code, const char* what){
+    std::strncpy(g_lastError, what, sizeof(g_lastError) - 1);
+    return code;
+}
+
 extern "C" {
 
 READER_API ICardReader* create_reader() {
@@ -15,7 +23,39 @@ READER_API void destroy_reader(ICardReader* p) {
 }
 
 READER_API const char* reader_library_version() {
-    return "acr38usb 0.3";
+    return "acr38usb 0.4";
+}
+
+READER_API size_t enumerate_readers(uint16_t vid, uint16_t pid, ReaderLocation* out, size_t cap) {
+    try {
+        const auto all = Acr38Usb::enumerate(vid, pid);
+        for (size_t i=0; i<all.size() && i<cap && out; ++i) out[i] = all[i];
+        return all.size();
+    } catch (...) {
+        return 0;
+    }
+}
+
+READER_API int reader_transmit_into(ICardReader* r, const uint8_t* capdu, size_t len,
+                                   uint8_t* rapdu, size_t cap, size_t* outLen, unsigned timeoutMs) {
+    if (!r || !capdu || !rapdu || !outLen) return fail(READER_E_ARGS, "Нулевой указатель в аргументах");
+    *outLen = 0;
+    try {
+        // create_reader этой библиотеки создаёт только Acr38Usb
+        *outLen = static_cast<Acr38Usb*>(r)->transmitInto(capdu, len, rapdu, cap, timeoutMs);
+        g_lastError[0] = 0;
+        return READER_OK;
+    } catch (const BufferTooSmall& e) {
+        return fail(READER_E_BUFFER, e.what());
+    } catch (const std::exception& e) {
+        return fail(READER_E_READER, e.what());
+    } catch (...) {
+        return fail(READER_E_READER, "Неизвестная ошибка");
+    }
+}
+
+READER_API const char* reader_last_error() {
+    return g_lastError;
 }
 
 }
@@ -0,0 +1,110 @@
+#include "faketransport.h"
+#include <algorithm>
+#include <cstring>
+
+namespace smartio {
+
+FakeTransport::FakeTransport(Responder r) : respond_(std::move(r)) {
+    thread_ = std::thread([this]{ loop(); });
+}
+
+FakeTransport::~FakeTransport() {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+FakeTransport::Script FakeTransport::split(const uint8_t* frame, size_t n, size_t packet, unsigned zlps, unsigned delayUs){
+    Script s(zlps);
+    if (!packet) packet = n ? n : 1;
+    for (size_t off=0; off<n; off+=packet)
+        s.push_back({std::vector<uint8_t>(frame + off, frame + std::min(n, off + packet)), 0, XferStatus::Completed});
+    if (!s.empty()) s.front().delayUs = delayUs;
+    return s;
+}
+
+void FakeTransport::interrupt(std::vector<uint8_t> data){
+    std::lock_guard<std::mutex> lk(m_);
+    intr_.push_back(std::move(data));
+    cv_.notify_all();
+}
+
+const char* FakeTransport::submit(Pipe p, uint8_t ep, uint8_t* buf, size_t n, unsigned timeoutMs){
+    (void)ep;
+    std::lock_guard<std::mutex> lk(m_);
+    Request& r = req_[(int)p];
+    if (r.pending) return "передача уже выставлена";
+    r = Request{true, false, buf, n,
+                timeoutMs ? Clock::now() + std::chrono::milliseconds(timeoutMs) : Clock::time_point::max()};
+    cv_.notify_all();
+    return nullptr;
+}
+
+void FakeTransport::cancel(Pipe p){
+    std::lock_guard<std::mutex> lk(m_);
+    if (req_[(int)p].pending) req_[(int)p].cancelled = true;
+    cv_.notify_all();
+}
+
+void FakeTransport::deliver(std::unique_lock<std::mutex>& lk, Pipe p, XferStatus st, size_t actual){
+    req_[(int)p].pending = false;
+    lk.unlock();
+    sink_->transferDone(p, st, actual);
+    lk.lock();
+}
+
+// Порядок как на шине: сначала OUT (он и порождает ответ), потом IN, потом Interrupt.
+void FakeTransport::loop(){
+    std::unique_lock<std::mutex> lk(m_);
+    while (!stop_) {
+        Request& out = req_[(int)Pipe::Out];
+        Request& in = req_[(int)Pipe::In];
+        Request& intr = req_[(int)Pipe::Intr];
+        if (out.pending) {
+            if (out.cancelled) { deliver(lk, Pipe::Out, XferStatus::Cancelled, 0); continue; }
+            const std::vector<uint8_t> frame(out.buf, out.buf + out.n);
+            lk.unlock();
+            Script s = respond_(frame.data(), frame.size());
+            lk.lock();
+            in_.insert(in_.end(), s.begin(), s.end());
+            deliver(lk, Pipe::Out, XferStatus::Completed, frame.size());
+            continue;
+        }
+        if (in.pending && in.cancelled) { deliver(lk, Pipe::In, XferStatus::Cancelled, 0); continue; }
+        const auto now = Clock::now();
+        if (in.pending && !in_.empty() && in_.front().delayUs) {
+            ready_ = now + std::chrono::microseconds(in_.front().delayUs);
+            in_.front().delayUs = 0;
+        }
+        if (in.pending && !in_.empty() && now >= ready_) {
+            Chunk& c = in_.front();
+            const size_t n = std::min(c.data.size(), in.n);
+            if (n) std::memcpy(in.buf, c.data.data(), n);     // ZLP: data() может быть null
+            const XferStatus st = c.status;
+            // не влезшее в буфер остаётся следующей передаче
+            if (n < c.data.size()) c.data.erase(c.data.begin(), c.data.begin() + n);
+            else in_.pop_front();
+            deliver(lk, Pipe::In, st, n);
+            continue;
+        }
+        // задержка куска не отменяет таймаут передачи
+        if (in.pending && now >= in.deadline) { deliver(lk, Pipe::In, XferStatus::TimedOut, 0); continue; }
+        if (intr.pending && intr.cancelled) { deliver(lk, Pipe::Intr, XferStatus::Cancelled, 0); continue; }
+        if (intr.pending && !intr_.empty()) {
+            const size_t n = std::min(intr_.front().size(), intr.n);
+            std::memcpy(intr.buf, intr_.front().data(), n);
+            intr_.pop_front();
+            deliver(lk, Pipe::Intr, XferStatus::Completed, n);
+            continue;
+        }
+        auto until = in.pending ? in.deadline : Clock::time_point::max();
+        if (in.pending && !in_.empty()) until = std::min(until, ready_);
+        if (until != Clock::time_point::max()) cv_.wait_until(lk, until);
+        else cv_.wait(lk);
+    }
+}
+
+} // namespace smartio
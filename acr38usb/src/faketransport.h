@@ -0,0 +1,70 @@
+#ifndef FAKETRANSPORT_H
+#define FAKETRANSPORT_H
+
+#pragma once
+#include "transport.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace smartio {
+
+// Транспорт в памяти: на каждый Bulk OUT ответ выдаёт сценарий вызывающего.
+// Ответ — последовательность передач Bulk IN: куски, короткие пакеты, ZLP,
+// задержки и ошибки. Завершения идут из собственного потока, как у libusb.
+class FakeTransport final : public UsbTransport {
+public:
+    struct Chunk {
+        std::vector<uint8_t> data;      // одна передача Bulk IN; пустая — ZLP
+        unsigned delayUs = 0;           // пауза перед завершением
+        XferStatus status = XferStatus::Completed;
+    };
+    using Script = std::vector<Chunk>;
+    using Responder = std::function<Script(const uint8_t* out, size_t n)>;
+
+    explicit FakeTransport(Responder r);
+    ~FakeTransport() override;
+
+    FakeTransport(const FakeTransport&) = delete;
+    FakeTransport& operator=(const FakeTransport&) = delete;
+
+    // Кадр кусками по packet байт (0 — целиком), перед ним zlps пустых передач,
+    // delayUs — перед первым куском.
+    static Script split(const uint8_t* frame, size_t n, size_t packet = 0, unsigned zlps = 0, unsigned delayUs = 0);
+    // Уведомление на Interrupt IN.
+    void interrupt(std::vector<uint8_t> data);
+
+    const char* submit(Pipe p, uint8_t ep, uint8_t* buf, size_t n, unsigned timeoutMs) override;
+    void cancel(Pipe p) override;
+    bool onEventThread() const override { return std::this_thread::get_id() == thread_.get_id(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Request {
+        bool pending = false, cancelled = false;
+        uint8_t* buf = nullptr;
+        size_t n = 0;
+        Clock::time_point deadline = Clock::time_point::max();
+    };
+
+    Responder respond_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    Request req_[3];
+    std::deque<Chunk> in_;
+    Clock::time_point ready_ = Clock::time_point::min();   // когда отдать голову in_
+    std::deque<std::vector<uint8_t>> intr_;
+    bool stop_ = false;
+    std::thread thread_;
+
+    void loop();
+    void deliver(std::unique_lock<std::mutex>& lk, Pipe p, XferStatus st, size_t actual);
+};
+
+} // namespace smartio
+
+#endif // FAKETRANSPORT_H
@@ -0,0 +1,79 @@
+#include "framepool.h"
+#include "ReaderApi.h"
+#include <utility>
+
+namespace smartio {
+
+Frame& Frame::operator=(Frame&& o) noexcept {
+    if (this != &o) {
+        release();
+        pool_ = o.pool_; p_ = o.p_; cap_ = o.cap_; size_ = o.size_; dev_ = o.dev_;
+        o.pool_ = nullptr; o.p_ = nullptr; o.cap_ = o.size_ = 0; o.dev_ = nullptr;
+    }
+    return *this;
+}
+
+void Frame::resize(size_t n){
+    if (n > cap_) throw ReaderError("Кадр превышает размер буфера пула");
+    size_ = n;
+}
+
+void Frame::release(){
+    if (!p_) return;
+    if (pool_) pool_->release({p_, cap_, dev_});
+    else FramePool::dispose({p_, cap_, dev_});
+    p_ = nullptr; cap_ = size_ = 0; dev_ = nullptr;
+}
+
+FramePool::Block FramePool::allocate(size_t cap){
+    if (h_ && devMem_) {
+        if (uint8_t* p = libusb_dev_mem_alloc(h_, cap)) return {p, cap, h_};
+    }
+    return {new uint8_t[cap], cap, nullptr};
+}
+
+void FramePool::dispose(const Block& b){
+    if (b.dev) libusb_dev_mem_free(b.dev, b.p, b.cap);
+    else delete[] b.p;
+}
+
+void FramePool::reset(libusb_device_handle* h, size_t frameSize, size_t count){
+    clear();
+    std::lock_guard<std::mutex> lk(m_);
+    h_ = h; frameSize_ = frameSize;
+    // пробная аллокация: старые ядра/не-Linux платформы dev_mem не умеют
+    devMem_ = true;
+    for (size_t i=0; i<count; ++i) {
+        Block b = allocate(frameSize_);
+        if (!b.dev) devMem_ = false;
+        free_.push_back(b);
+    }
+}
+
+void FramePool::clear(){
+    std::lock_guard<std::mutex> lk(m_);
+    for (auto& b : free_) dispose(b);
+    free_.clear();
+    h_ = nullptr; frameSize_ = 0; devMem_ = false;
+}
+
+Frame FramePool::acquire(size_t minCap){
+    Frame f;
+    std::lock_guard<std::mutex> lk(m_);
+    Block b{};
+    if (minCap <= frameSize_ && !free_.empty()) { b = free_.back(); free_.pop_back(); }
+    else if (frameSize_ && minCap <= frameSize_) b = allocate(frameSize_);
+    else { b = {new uint8_t[minCap ? minCap : 1], minCap ? minCap : 1, nullptr}; }
+    f.pool_ = (b.cap == frameSize_) ? this : nullptr;
+    f.p_ = b.p; f.cap_ = b.cap; f.dev_ = b.dev;
+    return f;
+}
+
+void FramePool::release(const Block& b){
+    std::lock_guard<std::mutex> lk(m_);
+    // dev_mem другого (закрытого) устройства в пул не возвращается
+    if (b.cap == frameSize_ && (!b.dev || b.dev == h_)) free_.push_back(b);
+    else dispose(b);
+}
+
+} // namespace smartio
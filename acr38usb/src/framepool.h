@@ -0,0 +1,83 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <libusb-1.0/libusb.h>
+
+namespace smartio {
+
+class FramePool;
+
+// Буфер кадра, взятый из пула ридера; при разрушении возвращается в пул.
+class Frame {
+public:
+    Frame() = default;
+    Frame(Frame&& o) noexcept { *this = std::move(o); }
+    Frame& operator=(Frame&& o) noexcept;
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
+    ~Frame() { release(); }
+
+    uint8_t* data() { return p_; }
+    const uint8_t* data() const { return p_; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return cap_; }
+    bool empty() const { return size_ == 0; }
+    void resize(size_t n);
+
+    uint8_t& operator[](size_t i) { return p_[i]; }
+    const uint8_t& operator[](size_t i) const { return p_[i]; }
+    const uint8_t* begin() const { return p_; }
+    const uint8_t* end() const { return p_ + size_; }
+
+private:
+    friend class FramePool;
+    FramePool* pool_ = nullptr;
+    uint8_t* p_ = nullptr;
+    size_t cap_ = 0, size_ = 0;
+    libusb_device_handle* dev_ = nullptr;   // dev_mem этого устройства; nullptr — куча
+
+    void release();
+};
+
+// Пул DMA-буферов ридера. Память берётся через libusb_dev_mem_alloc, если
+// usbfs это поддерживает, иначе обычной кучей. Размер кадра кратен
+// wMaxPacketSize, поэтому Bulk IN читается прямо в буфер без промежуточной копии.
+// Кадр помнит устройство своей dev_mem: возвращённый после clear() или reset()
+// на другое устройство освобождается libusb_dev_mem_free, а не delete[].
+class FramePool {
+public:
+    FramePool() = default;
+    ~FramePool() { clear(); }
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    void reset(libusb_device_handle* h, size_t frameSize, size_t count);
+    void clear();
+
+    Frame acquire(size_t minCap = 0);
+    size_t frameSize() const { return frameSize_; }
+    bool deviceMemory() const { return devMem_; }
+
+private:
+    friend class Frame;
+    struct Block { uint8_t* p; size_t cap; libusb_device_handle* dev; };
+
+    std::mutex m_;
+    libusb_device_handle* h_ = nullptr;
+    size_t frameSize_ = 0;
+    bool devMem_ = false;
+    std::vector<Block> free_;
+
+    Block allocate(size_t cap);
+    static void dispose(const Block& b);
+    void release(const Block& b);
+};
+
+} // namespace smartio
+
+#endif // FRAMEPOOL_H
@@ -0,0 +1,52 @@
+#include "libusbtransport.h"
+#include "ReaderApi.h"
+
+namespace smartio {
+namespace {
+XferStatus status(libusb_transfer_status st){
+    switch (st){
+    case LIBUSB_TRANSFER_COMPLETED: return XferStatus::Completed;
+    case LIBUSB_TRANSFER_TIMED_OUT: return XferStatus::TimedOut;
+    case LIBUSB_TRANSFER_CANCELLED: return XferStatus::Cancelled;
+    case LIBUSB_TRANSFER_STALL:     return XferStatus::Stall;
+    case LIBUSB_TRANSFER_NO_DEVICE: return XferStatus::NoDevice;
+    case LIBUSB_TRANSFER_OVERFLOW:  return XferStatus::Overflow;
+    default:                        return XferStatus::Error;
+    }
+}
+}
+
+LibusbTransport::LibusbTransport(std::shared_ptr<UsbContext> usb) : usb_(std::move(usb)) {
+    for (auto& x : x_) {
+        if ((x = libusb_alloc_transfer(0))) continue;
+        for (auto& y : x_) libusb_free_transfer(y);
+        throw ReaderError("libusb_alloc_transfer завершилась ошибкой");
+    }
+}
+
+LibusbTransport::~LibusbTransport() {
+    for (auto* x : x_) libusb_free_transfer(x);
+}
+
+const char* LibusbTransport::submit(Pipe p, uint8_t ep, uint8_t* buf, size_t n, unsigned timeoutMs){
+    if (!h_) return "нет устройства";
+    libusb_transfer* t = x_[(int)p];
+    if (p == Pipe::Intr)
+        libusb_fill_interrupt_transfer(t, h_, ep, buf, (int)n, &LibusbTransport::onDone, this, timeoutMs);
+    else
+        libusb_fill_bulk_transfer(t, h_, ep, buf, (int)n, &LibusbTransport::onDone, this, timeoutMs);
+    const int r = libusb_submit_transfer(t);
+    return r == 0 ? nullptr : libusb_error_name(r);
+}
+
+void LibusbTransport::cancel(Pipe p){
+    libusb_cancel_transfer(x_[(int)p]);
+}
+
+void LIBUSB_CALL LibusbTransport::onDone(libusb_transfer* t){
+    auto* self = static_cast<LibusbTransport*>(t->user_data);
+    const Pipe p = t == self->x_[0] ? Pipe::Out : t == self->x_[1] ? Pipe::In : Pipe::Intr;
+    self->sink_->transferDone(p, status(t->status), (size_t)t->actual_length);
+}
+
+} // namespace smartio
@@ -0,0 +1,38 @@
+#ifndef LIBUSBTRANSPORT_H
+#define LIBUSBTRANSPORT_H
+
+#pragma once
+#include "transport.h"
+#include "usbcontext.h"
+#include <memory>
+#include <libusb-1.0/libusb.h>
+
+namespace smartio {
+
+// Транспорт поверх libusb_submit_transfer; завершения — из общего потока UsbContext.
+class LibusbTransport final : public UsbTransport {
+public:
+    explicit LibusbTransport(std::shared_ptr<UsbContext> usb);
+    ~LibusbTransport() override;
+
+    LibusbTransport(const LibusbTransport&) = delete;
+    LibusbTransport& operator=(const LibusbTransport&) = delete;
+
+    // Меняется, только пока на движке нет выставленных передач.
+    void setHandle(libusb_device_handle* h) { h_ = h; }
+
+    const char* submit(Pipe p, uint8_t ep, uint8_t* buf, size_t n, unsigned timeoutMs) override;
+    void cancel(Pipe p) override;
+    bool onEventThread() const override { return usb_->onEventThread(); }
+
+private:
+    std::shared_ptr<UsbContext> usb_;
+    libusb_device_handle* h_ = nullptr;
+    libusb_transfer* x_[3] = {};
+
+    static void LIBUSB_CALL onDone(libusb_transfer* t);
+};
+
+} // namespace smartio
+
+#endif // LIBUSBTRANSPORT_H
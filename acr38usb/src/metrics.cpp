@@ -0,0 +1,85 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+
+namespace smartio {
+
+size_t LatencyHistogram::index(uint64_t v){
+    if (v < SUB) return (size_t)v;
+    unsigned msb = 63 - (unsigned)__builtin_clzll(v);
+    if (msb > MAX_MSB) { msb = MAX_MSB; v = (uint64_t(2) << MAX_MSB) - 1; }
+    const unsigned shift = msb - SUB_BITS;
+    return SUB + (size_t)(msb - SUB_BITS) * SUB + (size_t)((v >> shift) - SUB);
+}
+
+uint64_t LatencyHistogram::upper(size_t i){
+    if (i < SUB) return i;
+    const size_t octave = (i - SUB) / SUB, sub = (i - SUB) % SUB;
+    return ((uint64_t)(SUB + sub + 1) << octave) - 1;
+}
+
+void LatencyHistogram::record(uint64_t us){
+    buckets_[index(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(us, std::memory_order_relaxed);
+    uint64_t m = min_.load(std::memory_order_relaxed);
+    while (us < m && !min_.compare_exchange_weak(m, us, std::memory_order_relaxed)) {}
+    m = max_.load(std::memory_order_relaxed);
+    while (us > m && !max_.compare_exchange_weak(m, us, std::memory_order_relaxed)) {}
+}
+
+uint64_t LatencyHistogram::percentile(double q, uint64_t total) const {
+    const uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(q * (double)total));
+    uint64_t seen = 0;
+    for (size_t i=0; i<BUCKETS; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return std::min(upper(i), max_.load(std::memory_order_relaxed));
+    }
+    return max_.load(std::memory_order_relaxed);
+}
+
+LatencyStats LatencyHistogram::snapshot() const {
+    LatencyStats s;
+    // счётчик по корзинам, а не count_: снимок согласован с самими корзинами
+    for (const auto& b : buckets_) s.count += b.load(std::memory_order_relaxed);
+    if (!s.count) return s;
+    s.minUs = min_.load(std::memory_order_relaxed);
+    s.maxUs = max_.load(std::memory_order_relaxed);
+    const uint64_t n = count_.load(std::memory_order_relaxed);
+    s.meanUs = n ? sum_.load(std::memory_order_relaxed) / n : 0;
+    s.p50Us  = percentile(0.50,  s.count);
+    s.p90Us  = percentile(0.90,  s.count);
+    s.p99Us  = percentile(0.99,  s.count);
+    s.p999Us = percentile(0.999, s.count);
+    return s;
+}
+
+void LatencyHistogram::reset(){
+    for (auto& b : buckets_) b.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    min_.store(UINT64_MAX, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+ReaderStats ReaderMetrics::snapshot(bool reset){
+    ReaderStats s;
+    for (size_t i=0; i<STAT_OPS; ++i) {
+        s.latency[i] = lat_[i].snapshot();
+        if (reset) lat_[i].reset();
+    }
+    auto take = [reset](std::atomic<uint64_t>& a){
+        return reset ? a.exchange(0, std::memory_order_relaxed) : a.load(std::memory_order_relaxed);
+    };
+    s.exchanges = take(exchanges);
+    s.bytesOut  = take(bytesOut);
+    s.bytesIn   = take(bytesIn);
+    s.partialIn = take(partialIn);
+    s.timeouts  = take(timeouts);
+    s.retries   = take(retries);
+    s.timeExtensions = take(timeExtensions);
+    s.errors    = take(errors);
+    return s;
+}
+
+} // namespace smartio
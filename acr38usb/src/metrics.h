@@ -0,0 +1,64 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#pragma once
+#include "ReaderApi.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace smartio {
+
+// Гистограмма задержек в мкс с логарифмически-линейными корзинами (как в
+// HdrHistogram): до 16 мкс — по корзине на значение, дальше каждая октава
+// делится на 16 корзин, относительная погрешность не больше 1/16.
+// Запись — несколько атомарных инкрементов без блокировок.
+class LatencyHistogram {
+public:
+    LatencyHistogram() { reset(); }
+    void record(uint64_t us);
+    LatencyStats snapshot() const;
+    void reset();
+
+private:
+    static constexpr unsigned SUB_BITS = 4;
+    static constexpr unsigned SUB = 1u << SUB_BITS;
+    static constexpr unsigned MAX_MSB = 40;          // ~12 суток в мкс
+    static constexpr size_t BUCKETS = SUB + (MAX_MSB - SUB_BITS + 1) * SUB;
+
+    std::atomic<uint64_t> buckets_[BUCKETS];
+    std::atomic<uint64_t> count_, sum_, min_, max_;
+
+    static size_t index(uint64_t v);
+    static uint64_t upper(size_t i);
+    uint64_t percentile(double q, uint64_t total) const;
+};
+
+class ReaderMetrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void record(StatOp op, Clock::time_point start){
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+        recordUs(op, us > 0 ? (uint64_t)us : 0);
+    }
+    void recordUs(StatOp op, uint64_t us){ lat_[(size_t)op].record(us); }
+    void exchange(StatOp op, Clock::time_point start, size_t out, size_t in){
+        record(op, start);
+        exchanges.fetch_add(1, std::memory_order_relaxed);
+        bytesOut.fetch_add(out, std::memory_order_relaxed);
+        bytesIn.fetch_add(in, std::memory_order_relaxed);
+    }
+
+    ReaderStats snapshot(bool reset);
+
+    std::atomic<uint64_t> exchanges{0}, bytesOut{0}, bytesIn{0};
+    std::atomic<uint64_t> partialIn{0}, timeouts{0}, retries{0}, errors{0}, timeExtensions{0};
+
+private:
+    LatencyHistogram lat_[STAT_OPS];
+};
+
+} // namespace smartio
+
+#endif // METRICS_H
@@ -0,0 +1,181 @@
+#include "replayreader.h"
+#include "Atr.h"
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace smartio {
+
+void ReplayReader::open(const OpenParams& p){
+    std::string file = p.replayFile;
+    bool timing = p.replayTiming;
+    if (file.empty()) if (const char* e = std::getenv("SMARTIO_REPLAY_FILE")) file = e;
+    if (const char* e = std::getenv("SMARTIO_REPLAY_TIMING")) timing = timing || std::strcmp(e, "0") != 0;
+    if (file.empty()) throw ReaderError("Не задан файл сессии (replayFile / SMARTIO_REPLAY_FILE)");
+    auto recs = readSession(file);
+
+    std::lock_guard<std::mutex> lk(m_);
+    records_ = std::move(recs);
+    file_ = file;
+    timing_ = timing;
+    atrs_.clear(); byCmd_.clear();
+    nextAtr_ = 0;
+    for (size_t i=0; i<records_.size(); ++i) {
+        const auto& r = records_[i];
+        if (r.kind == SessionRecord::Kind::Atr) atrs_.push_back(i);
+        else if (r.kind == SessionRecord::Kind::Xfr)
+            byCmd_[std::string(r.cmd.begin(), r.cmd.end())].records.push_back(i);
+    }
+    if (atrs_.empty()) throw ReaderError("В файле сессии нет ATR: " + file);
+    atr_.clear();
+    powered_ = false;
+    open_ = true;
+}
+
+void ReplayReader::close(){
+    std::lock_guard<std::mutex> lk(m_);
+    open_ = powered_ = false;
+    records_.clear(); atrs_.clear(); byCmd_.clear(); atr_.clear();
+}
+
+ReaderInfo ReplayReader::info() const {
+    std::lock_guard<std::mutex> lk(m_);
+    ReaderInfo i;
+    i.name = "Replay";
+    i.backend = "replay";
+    i.path = file_;
+    i.level = ExchangeLevel::ExtendedApdu;
+    i.maxCommandData = 65535;
+    i.maxResponseData = 65536;
+    if (powered_) {
+        const AtrInfo a = parseAtr(atr_);
+        i.activeProtocol = a.protocol;
+    }
+    return i;
+}
+
+CardPresence ReplayReader::cardStatus(){
+    std::lock_guard<std::mutex> lk(m_);
+    if (!open_) throw ReaderError("Закрытый");
+    return powered_ ? CardPresence::PresentActive : CardPresence::PresentInactive;
+}
+
+std::vector<uint8_t> ReplayReader::powerOn(ResetMode mode){
+    const auto started = ReaderMetrics::Clock::now();
+    CardEventCallback cb;
+    SessionRecord rec;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        if (!open_) throw ReaderError("Закрытый");
+        if (mode == ResetMode::Reuse && powered_) return atr_;
+        rec = records_[atrs_[nextAtr_]];
+        nextAtr_ = (nextAtr_ + 1) % atrs_.size();
+        atr_ = rec.rsp;
+        powered_ = true;
+        cb = cardCb_;
+    }
+    pace(rec, started);
+    metrics_.record(StatOp::IccPowerOn, started);
+    if (cb) cb(0, CardPresence::PresentActive);
+    return rec.rsp;
+}
+
+void ReplayReader::powerOff(){
+    CardEventCallback cb;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        if (!open_) throw ReaderError("Закрытый");
+        atr_.clear();
+        powered_ = false;
+        cb = cardCb_;
+    }
+    if (cb) cb(0, CardPresence::PresentInactive);
+}
+
+// Карта из файла не вынимается: событий нет, ожидание — просто пауза.
+bool ReplayReader::waitCardEvent(unsigned timeoutMs){
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+    return false;
+}
+
+void ReplayReader::setCardEventCallback(CardEventCallback cb){
+    std::lock_guard<std::mutex> lk(m_);
+    cardCb_ = std::move(cb);
+}
+
+SessionRecord ReplayReader::answer(const uint8_t* capdu, size_t len){
+    std::lock_guard<std::mutex> lk(m_);
+    if (!open_) throw ReaderError("Закрытый");
+    if (!powered_) throw ReaderError("Карта не активирована (powerOn)");
+    auto it = byCmd_.find(std::string(capdu, capdu + len));
+    if (it == byCmd_.end())
+        throw ReaderError("Команда отсутствует в файле сессии: " + sessionHex(capdu, len));
+    auto& a = it->second;
+    const size_t i = a.records[a.next];
+    a.next = (a.next + 1) % a.records.size();
+    return records_[i];
+}
+
+// В исходном темпе: обмен занимает не меньше записанного времени.
+void ReplayReader::pace(const SessionRecord& r, ReaderMetrics::Clock::time_point started) const {
+    if (timing_) std::this_thread::sleep_until(started + std::chrono::microseconds(r.us));
+}
+
+XfrResult ReplayReader::transmit(const std::vector<uint8_t>& capdu, unsigned timeoutMs){
+    (void)timeoutMs;
+    const auto started = ReaderMetrics::Clock::now();
+    const auto r = answer(capdu.data(), capdu.size());
+    pace(r, started);
+    metrics_.record(StatOp::Apdu, started);
+    return XfrResult{r.rsp};
+}
+
+// Ответ готов сразу: done вызывается в потоке вызывающего.
+void ReplayReader::transmitAsync(const std::vector<uint8_t>& capdu, XfrCallback done, unsigned timeoutMs){
+    XfrResult xr;
+    std::exception_ptr err;
+    try { xr = transmit(capdu, timeoutMs); }
+    catch (...) { err = std::current_exception(); }
+    if (done) done(std::move(xr), err);
+}
+
+BatchResult ReplayReader::transmitBatch(const ApduBatch& batch, unsigned timeoutMs){
+    (void)timeoutMs;
+    BatchResult res;
+    res.offsets.reserve(batch.size());
+    for (size_t i=0; i<batch.size(); ++i) {
+        const auto started = ReaderMetrics::Clock::now();
+        const auto r = answer(batch.apdu(i), batch.length(i));
+        pace(r, started);
+        metrics_.record(StatOp::Apdu, started);
+        res.offsets.push_back(res.data.size());
+        res.data.insert(res.data.end(), r.rsp.begin(), r.rsp.end());
+        if (batch.stopOnError[i] && res.sw(i) != 0x9000) break;
+    }
+    return res;
+}
+
+size_t ReplayReader::transmitInto(const uint8_t* capdu, size_t len, uint8_t* rapdu, size_t cap){
+    const auto started = ReaderMetrics::Clock::now();
+    const auto r = answer(capdu, len);
+    pace(r, started);
+    if (r.rsp.size() <= cap) std::memcpy(rapdu, r.rsp.data(), r.rsp.size());
+    metrics_.record(StatOp::Apdu, started);
+    return r.rsp.size();
+}
+
+std::vector<uint8_t> ReplayReader::vendorControl(const std::vector<uint8_t>& payload){
+    (void)payload;
+    return {};
+}
+
+ReaderStats ReplayReader::stats(bool reset){
+    return metrics_.snapshot(reset);
+}
+
+size_t ReplayReader::dumpTrace(const std::string& pcapPath){
+    (void)pcapPath;
+    throw ReaderError("Трассировка USB недоступна: ридер воспроизводит файл сессии");
+}
+
+} // namespace smartio
@@ -0,0 +1,69 @@
+#ifndef REPLAYREADER_H
+#define REPLAYREADER_H
+
+#pragma once
+#include "ReaderApi.h"
+#include "SessionFile.h"
+#include "metrics.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace smartio {
+
+// Ридер без железа: отвечает по файлу сессии, записанному Acr38Usb
+// (OpenParams::recordFile). Одинаковые команды получают записанные ответы
+// по очереди, по кругу; незаписанная команда — ReaderError.
+class ReplayReader final : public ICardReader {
+public:
+    void open(const OpenParams& params) override;
+    void close() override;
+    ReaderInfo info() const override;
+
+    CardPresence cardStatus() override;
+    std::vector<uint8_t> powerOn(ResetMode mode = ResetMode::Cold) override;
+    void powerOff() override;
+    bool waitCardEvent(unsigned timeoutMs) override;
+    void setCardEventCallback(CardEventCallback cb) override;
+
+    XfrResult transmit(const std::vector<uint8_t>& capdu,
+                       unsigned timeoutMs) override;
+    void transmitAsync(const std::vector<uint8_t>& capdu,
+                       XfrCallback done,
+                       unsigned timeoutMs) override;
+    using ICardReader::transmitAsync;
+    BatchResult transmitBatch(const ApduBatch& batch, unsigned timeoutMs) override;
+    // Длина ответа; больше cap — ответ не скопирован.
+    size_t transmitInto(const uint8_t* capdu, size_t len, uint8_t* rapdu, size_t cap);
+
+    std::vector<uint8_t> vendorControl(const std::vector<uint8_t>& payload) override;
+
+    ReaderStats stats(bool reset) override;
+    size_t dumpTrace(const std::string& pcapPath) override;
+
+private:
+    struct Answers {
+        std::vector<size_t> records;
+        size_t next = 0;
+    };
+
+    mutable std::mutex m_;
+    std::string file_;
+    bool open_ = false, powered_ = false, timing_ = false;
+    std::vector<SessionRecord> records_;
+    std::vector<size_t> atrs_;
+    size_t nextAtr_ = 0;
+    std::vector<uint8_t> atr_;
+    std::unordered_map<std::string, Answers> byCmd_;
+    CardEventCallback cardCb_;
+    ReaderMetrics metrics_;
+
+    // копия: close() или повторная загрузка очищают records_
+    SessionRecord answer(const uint8_t* capdu, size_t len);
+    void pace(const SessionRecord& r, ReaderMetrics::Clock::time_point started) const;
+};
+
+} // namespace smartio
+
+#endif // REPLAYREADER_H
@@ -0,0 +1,176 @@
+#include "t1proto.h"
+#include "ReaderApi.h"
+#include <algorithm>
+
+namespace smartio {
+namespace {
+constexpr uint8_t NAD         = 0x00;
+constexpr uint8_t PCB_M       = 0x20;   // I-блок: есть продолжение
+constexpr uint8_t R_BLOCK     = 0x80;
+constexpr uint8_t R_ERR_EDC   = 0x01;
+constexpr uint8_t R_ERR_OTHER = 0x02;
+constexpr uint8_t S_RESYNCH   = 0xC0;
+constexpr uint8_t S_IFS       = 0xC1;
+constexpr uint8_t S_ABORT     = 0xC2;
+constexpr uint8_t S_WTX       = 0xC3;
+constexpr uint8_t S_RESPONSE  = 0x20;
+constexpr int     MAX_RETRIES = 3;
+
+bool isIBlock(uint8_t pcb){ return (pcb & 0x80) == 0; }
+bool isRBlock(uint8_t pcb){ return (pcb & 0xC0) == 0x80; }
+
+uint16_t crc16(const uint8_t* p, size_t n){
+    uint16_t crc = 0xFFFF;
+    for (size_t i=0;i<n;++i){
+        crc ^= p[i];
+        for (int b=0;b<8;++b) crc = (crc & 1) ? (crc>>1) ^ 0x8408 : (crc>>1);
+    }
+    return ~crc;
+}
+}
+
+void T1Protocol::reset(const AtrInfo& a){
+    ifsc_ = (a.ifsc && a.ifsc != 0xFF) ? a.ifsc : 32;
+    ifsd_ = 32;
+    crc_ = a.crc;
+    ns_ = nr_ = 0;
+}
+
+std::vector<uint8_t> T1Protocol::block(uint8_t pcb, const uint8_t* inf, size_t n) const {
+    std::vector<uint8_t> b; b.reserve(3 + n + 2);
+    b.push_back(NAD); b.push_back(pcb); b.push_back((uint8_t)n);
+    b.insert(b.end(), inf, inf + n);
+    if (crc_) {
+        const uint16_t c = crc16(b.data(), b.size());
+        b.push_back(uint8_t(c >> 8)); b.push_back(uint8_t(c & 0xFF));
+    } else {
+        uint8_t lrc = 0;
+        for (auto v : b) lrc ^= v;
+        b.push_back(lrc);
+    }
+    return b;
+}
+
+bool T1Protocol::valid(const std::vector<uint8_t>& b) const {
+    const size_t edc = crc_ ? 2 : 1;
+    if (b.size() < 3 + edc || b[2] == 0xFF || b.size() != 3u + b[2] + edc) return false;
+    if (crc_) {
+        const uint16_t c = crc16(b.data(), b.size() - 2);
+        return b[b.size()-2] == uint8_t(c >> 8) && b[b.size()-1] == uint8_t(c & 0xFF);
+    }
+    uint8_t lrc = 0;
+    for (auto v : b) lrc ^= v;
+    return lrc == 0;
+}
+
+bool T1Protocol::negotiateIfsd(const BlockIo& io, uint8_t ifsd){
+    if (!ifsd || ifsd == 0xFF) return false;
+    const auto req = block(S_IFS, &ifsd, 1);
+    for (int i=0; i<MAX_RETRIES; ++i){
+        try {
+            auto rx = io(req, 0);
+            if (valid(rx) && rx[1] == (S_IFS | S_RESPONSE) && rx[2] == 1 && rx[3] == ifsd) {
+                ifsd_ = ifsd;
+                return true;
+            }
+        } catch (const ReaderError&) {}
+    }
+    return false;
+}
+
+void T1Protocol::resync(const BlockIo& io){
+    const auto req = block(S_RESYNCH, nullptr, 0);
+    for (int i=0; i<MAX_RETRIES; ++i){
+        try {
+            auto rx = io(req, 0);
+            if (valid(rx) && rx[1] == (S_RESYNCH | S_RESPONSE)) break;
+        } catch (const ReaderError&) {}
+    }
+    ns_ = nr_ = 0;
+    ifsd_ = 32;
+}
+
+std::vector<uint8_t> T1Protocol::transceive(const BlockIo& io, const std::vector<uint8_t>& apdu){
+    std::vector<uint8_t> resp;
+    size_t off = 0, chunk = 0;
+    bool chaining = false;      // отправлен наш I-блок с M, ждём R-подтверждения
+    bool answering = false;     // карта уже начала отвечать I-блоками
+
+    auto nextI = [&]{
+        chunk = std::min<size_t>(ifsc_, apdu.size() - off);
+        chaining = off + chunk < apdu.size();
+        return block(uint8_t((ns_ << 6) | (chaining ? PCB_M : 0)), apdu.data() + off, chunk);
+    };
+
+    std::vector<uint8_t> last = nextI();    // последний отправленный блок — для повтора
+    std::vector<uint8_t> tx = last;
+    uint8_t wtx = 0;
+    int errors = 0;
+
+    auto retry = [&](uint8_t err){
+        if (retries_) retries_->fetch_add(1, std::memory_order_relaxed);
+        if (++errors > MAX_RETRIES) {
+            resync(io);
+            throw ReaderError("T=1: превышено число повторов, протокол пересинхронизирован");
+        }
+        // до первого ответа карты повторяем свой блок, иначе просим повтор её блока
+        tx = answering ? block(uint8_t(R_BLOCK | (nr_ << 4) | err), nullptr, 0) : last;
+    };
+
+    while (true) {
+        std::vector<uint8_t> rx;
+        try { rx = io(tx, wtx); }
+        catch (const ReaderError&) { wtx = 0; retry(R_ERR_OTHER); continue; }
+        wtx = 0;
+        if (!valid(rx)) { retry(R_ERR_EDC); continue; }
+
+        const uint8_t pcb = rx[1];
+        const uint8_t* inf = rx.data() + 3;
+        const size_t len = rx[2];
+
+        if (isIBlock(pcb)) {
+            if (chaining || ((pcb >> 6) & 1) != nr_) { retry(R_ERR_OTHER); continue; }
+            if (!answering) { ns_ ^= 1; answering = true; }   // I-блок карты подтверждает наш последний
+            resp.insert(resp.end(), inf, inf + len);
+            nr_ ^= 1;
+            errors = 0;
+            if (pcb & PCB_M) { tx = last = block(uint8_t(R_BLOCK | (nr_ << 4)), nullptr, 0); continue; }
+            return resp;
+        }
+        if (isRBlock(pcb)) {
+            const uint8_t nr = (pcb >> 4) & 1;
+            if (chaining && !answering && nr != ns_) {
+                // подтверждение очередного блока цепочки команды
+                ns_ ^= 1; off += chunk; errors = 0;
+                tx = last = nextI();
+                continue;
+            }
+            if (retries_) retries_->fetch_add(1, std::memory_order_relaxed);
+            if (++errors > MAX_RETRIES) {
+                resync(io);
+                throw ReaderError("T=1: карта не принимает блок, протокол пересинхронизирован");
+            }
+            tx = last;
+            continue;
+        }
+        // S-блоки
+        switch (pcb) {
+        case S_WTX:
+            wtx = len ? inf[0] : 1;
+            tx = block(S_WTX | S_RESPONSE, inf, len);
+            break;
+        case S_IFS:
+            if (len) ifsc_ = inf[0];
+            tx = block(S_IFS | S_RESPONSE, inf, len);
+            break;
+        case S_ABORT:
+            (void)io(block(S_ABORT | S_RESPONSE, nullptr, 0), 0);
+            throw ReaderError("T=1: карта прервала обмен (S(ABORT))");
+        default:
+            retry(R_ERR_OTHER);
+            break;
+        }
+    }
+}
+
+} // namespace smartio
@@ -0,0 +1,45 @@
+#ifndef T1PROTO_H
+#define T1PROTO_H
+
+#pragma once
+#include "Atr.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace smartio {
+
+// Блочный протокол T=1 (ISO/IEC 7816-3, раздел 11) на стороне хоста:
+// I-блоки с цепочками, R-блоки для подтверждений и повторов, S-блоки
+// IFS/WTX/ABORT/RESYNCH. Нужен ридерам уровня TPDU и ACS EXCHANGE_T1.
+class T1Protocol {
+public:
+    // Обмен одним блоком (пролог + INF + EDC) с картой. wtx — множитель BWT
+    // для этого обмена (0 — без продления). Ошибка/таймаут — ReaderError.
+    using BlockIo = std::function<std::vector<uint8_t>(const std::vector<uint8_t>& block, uint8_t wtx)>;
+
+    void reset(const AtrInfo& a);
+    bool negotiateIfsd(const BlockIo& io, uint8_t ifsd);
+    std::vector<uint8_t> transceive(const BlockIo& io, const std::vector<uint8_t>& apdu);
+    // S(RESYNCH): N(S)/N(R) карты неизвестны (сессия чужого процесса)
+    void resync(const BlockIo& io);
+
+    void countRetries(std::atomic<uint64_t>* counter) { retries_ = counter; }
+    uint8_t ifsc() const { return ifsc_; }
+    uint8_t ifsd() const { return ifsd_; }
+
+private:
+    uint8_t ifsc_ = 32, ifsd_ = 32;
+    bool crc_ = false;
+    uint8_t ns_ = 0;    // N(S) нашего следующего I-блока
+    uint8_t nr_ = 0;    // ожидаемый N(S) I-блока карты
+    std::atomic<uint64_t>* retries_ = nullptr;
+
+    std::vector<uint8_t> block(uint8_t pcb, const uint8_t* inf, size_t n) const;
+    bool valid(const std::vector<uint8_t>& b) const;
+};
+
+} // namespace smartio
+
+#endif // T1PROTO_H
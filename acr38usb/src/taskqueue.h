@@ -0,0 +1,89 @@
+#ifndef TASKQUEUE_H
+#define TASKQUEUE_H
+
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace smartio {
+
+// Последовательное выполнение задач в отдельном потоке. Нужен обменам,
+// которые ведутся синхронно (T=1 на стороне хоста), но обслуживают
+// transmitAsync. Поток запускается при первой задаче.
+// Состояние очереди держит и сам поток: stop() и даже разрушение очереди
+// из её же задачи не оставляют loop() с освобождённой памятью.
+class TaskQueue {
+public:
+    TaskQueue() = default;
+    TaskQueue(const TaskQueue&) = delete;
+    TaskQueue& operator=(const TaskQueue&) = delete;
+    ~TaskQueue() {
+        {
+            // из своей задачи: владелец разрушается, его задачи выполнять уже нельзя
+            std::lock_guard<std::mutex> lk(st_->m);
+            if (std::this_thread::get_id() == st_->worker) st_->q.clear();
+        }
+        stop();
+    }
+
+    void post(std::function<void()> f){
+        std::lock_guard<std::mutex> lk(st_->m);
+        st_->q.push_back(std::move(f));
+        // поток, остановленный изнутри задачи, дорабатывает очередь сам: второго не запускаем
+        if (!st_->running) {
+            if (th_.joinable()) th_.join();     // loop() уже вернулся
+            st_->stop = false; st_->running = true;
+            th_ = std::thread([st = st_]{ loop(*st); });
+        }
+        st_->cv.notify_all();
+    }
+
+    // Дорабатывает очередь и останавливает поток.
+    void stop(){
+        std::unique_lock<std::mutex> lk(st_->m);
+        st_->stop = true;
+        st_->cv.notify_all();
+        if (std::this_thread::get_id() == st_->worker) {
+            if (th_.get_id() == st_->worker) th_.detach();
+            return;
+        }
+        st_->cv.wait(lk, [this]{ return !st_->running; });
+        std::thread t = std::move(th_);
+        lk.unlock();
+        if (t.joinable()) t.join();
+    }
+
+private:
+    struct State {
+        std::mutex m;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> q;
+        bool stop = false;
+        bool running = false;       // loop() ещё не вернулся (в том числе в отсоединённом потоке)
+        std::thread::id worker;     // поток, выполняющий loop()
+    };
+    std::shared_ptr<State> st_ = std::make_shared<State>();
+    std::thread th_;
+
+    static void loop(State& st){
+        std::unique_lock<std::mutex> lk(st.m);
+        st.worker = std::this_thread::get_id();
+        while (true) {
+            st.cv.wait(lk, [&st]{ return st.stop || !st.q.empty(); });
+            if (st.q.empty()) { st.running = false; st.worker = {}; st.cv.notify_all(); return; }
+            auto f = std::move(st.q.front());
+            st.q.pop_front();
+            lk.unlock();
+            f();
+            lk.lock();
+        }
+    }
+};
+
+} // namespace smartio
+
+#endif // TASKQUEUE_H
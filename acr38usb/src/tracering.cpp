@@ -0,0 +1,107 @@
+#include "tracering.h"
+#include "ReaderApi.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace smartio {
+namespace {
+constexpr uint32_t PCAP_MAGIC         = 0xA1B2C3D4;
+constexpr uint32_t LINKTYPE_USB_LINUX = 189;
+
+#pragma pack(push, 1)
+struct PcapHeader {
+    uint32_t magic; uint16_t major, minor; int32_t zone; uint32_t sigfigs, snaplen, linktype;
+};
+struct PcapRecord {
+    uint32_t sec, usec, capLen, origLen;
+};
+// struct usbmon_packet (Documentation/usb/usbmon.rst), порядок байт хоста
+struct UsbmonHeader {
+    uint64_t id;
+    uint8_t type, xferType, epnum, devnum;
+    uint16_t busnum;
+    char flagSetup, flagData;
+    int64_t tsSec;
+    int32_t tsUsec;
+    int32_t status;
+    uint32_t length, lenCap;
+    uint8_t setup[8];
+};
+#pragma pack(pop)
+static_assert(sizeof(UsbmonHeader) == 48, "usbmon header");
+
+uint64_t monoNs(){
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+void TraceRing::record(uint64_t urb, Kind kind, uint8_t xferType, uint8_t ep,
+                       const uint8_t* data, size_t len, int32_t status){
+    const uint64_t n = head_.fetch_add(1, std::memory_order_relaxed);
+    Slot& s = slots_[n % SLOTS];
+    const uint64_t gen = n / SLOTS;
+    s.seq.store(2*gen + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.tsNs = monoNs();
+    s.urb = urb;
+    s.len = (uint32_t)len;
+    s.status = status;
+    s.kind = (uint8_t)kind; s.xferType = xferType; s.ep = ep;
+    s.cap = (uint8_t)std::min(len, SNAP);
+    if (s.cap) std::memcpy(s.data, data, s.cap);
+    s.seq.store(2*gen + 2, std::memory_order_release);
+}
+
+size_t TraceRing::dumpPcap(const std::string& path) const {
+    // снимок кольца: от старых записей к новым, слоты под записью пропускаются
+    struct Copy { uint64_t tsNs, urb; uint32_t len; int32_t status; uint8_t kind, xferType, ep, cap; uint8_t data[SNAP]; };
+    const uint64_t end = head_.load(std::memory_order_acquire);
+    const uint64_t begin = end > SLOTS ? end - SLOTS : 0;
+    std::vector<Copy> out;
+    out.reserve((size_t)(end - begin));
+    for (uint64_t n = begin; n < end; ++n) {
+        const Slot& s = slots_[n % SLOTS];
+        const uint64_t want = 2*(n / SLOTS) + 2;
+        if (s.seq.load(std::memory_order_acquire) != want) continue;
+        Copy c{s.tsNs, s.urb, s.len, s.status, s.kind, s.xferType, s.ep, s.cap, {}};
+        std::memcpy(c.data, s.data, c.cap);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) != want) continue;
+        out.push_back(c);
+    }
+
+    std::unique_ptr<FILE, int(*)(FILE*)> f(std::fopen(path.c_str(), "wb"), &std::fclose);
+    if (!f) throw ReaderError("Не удалось создать файл трассы: " + path);
+    const PcapHeader ph{PCAP_MAGIC, 2, 4, 0, 0, (uint32_t)(sizeof(UsbmonHeader) + SNAP), LINKTYPE_USB_LINUX};
+    std::fwrite(&ph, sizeof(ph), 1, f.get());
+
+    // монотонное время — в календарное по текущему смещению часов
+    const int64_t offsetNs = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count() - (int64_t)monoNs();
+    for (const auto& c : out) {
+        const int64_t ts = (int64_t)c.tsNs + offsetNs;
+        UsbmonHeader u{};
+        u.id = c.urb;
+        u.type = c.kind; u.xferType = c.xferType; u.epnum = c.ep; u.devnum = address_;
+        u.busnum = bus_;
+        u.flagSetup = '-';
+        u.flagData = c.cap ? '=' : '<';
+        u.tsSec = ts / 1000000000; u.tsUsec = (int32_t)((ts % 1000000000) / 1000);
+        u.status = c.status;
+        u.length = c.len; u.lenCap = c.cap;
+        const PcapRecord r{(uint32_t)u.tsSec, (uint32_t)u.tsUsec,
+                           (uint32_t)(sizeof(u) + c.cap), (uint32_t)(sizeof(u) + c.len)};
+        std::fwrite(&r, sizeof(r), 1, f.get());
+        std::fwrite(&u, sizeof(u), 1, f.get());
+        std::fwrite(c.data, 1, c.cap, f.get());
+    }
+    if (std::fflush(f.get()) != 0) throw ReaderError("Ошибка записи файла трассы: " + path);
+    return out.size();
+}
+
+} // namespace smartio
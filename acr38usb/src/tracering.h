@@ -0,0 +1,50 @@
+#ifndef TRACERING_H
+#define TRACERING_H
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace smartio {
+
+// Кольцо последних кадров USB (Bulk OUT/IN, interrupt) для разбора задержек
+// в работающей системе. Запись без блокировок: слот защищён счётчиком
+// (seqlock), читатель пропускает слоты, переписанные во время копирования.
+// Кадр хранится первыми SNAP байтами — заголовок CCID и короткий APDU целиком.
+class TraceRing {
+public:
+    static constexpr size_t SLOTS = 4096;
+    static constexpr size_t SNAP  = 128;
+
+    enum class Kind : uint8_t { Submit = 'S', Complete = 'C', Error = 'E' };
+
+    void setDevice(uint16_t bus, uint8_t address) { bus_ = bus; address_ = address; }
+    void record(uint64_t urb, Kind kind, uint8_t xferType, uint8_t ep,
+                const uint8_t* data, size_t len, int32_t status = 0);
+
+    // pcap с LINKTYPE_USB_LINUX (usbmon): открывается Wireshark как захват USB.
+    // Возвращает число записанных пакетов.
+    size_t dumpPcap(const std::string& path) const;
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq{0};   // нечётный — слот пишется
+        uint64_t tsNs = 0;
+        uint64_t urb = 0;
+        uint32_t len = 0;
+        int32_t status = 0;
+        uint8_t kind = 0, xferType = 0, ep = 0, cap = 0;
+        uint8_t data[SNAP];
+    };
+
+    Slot slots_[SLOTS];
+    std::atomic<uint64_t> head_{0};
+    uint16_t bus_ = 0;
+    uint8_t address_ = 0;
+};
+
+} // namespace smartio
+
+#endif // TRACERING_H
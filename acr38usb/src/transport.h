@@ -0,0 +1,40 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace smartio {
+
+// Исход передачи (как libusb_transfer_status).
+enum class XferStatus { Completed, Error, TimedOut, Cancelled, Stall, NoDevice, Overflow };
+
+enum class Pipe { Out, In, Intr };
+
+// Ввод-вывод USB под UsbEngine: на каждом канале не больше одной выставленной
+// передачи, завершение приходит в Sink из потока событий транспорта.
+// Кадрирование, сборка ответа и очередь обменов остаются в движке.
+class UsbTransport {
+public:
+    struct Sink {
+        virtual void transferDone(Pipe p, XferStatus st, size_t actual) = 0;
+    protected:
+        ~Sink() = default;
+    };
+
+    virtual ~UsbTransport() = default;
+    void bind(Sink* s) { sink_ = s; }
+
+    // nullptr — передача выставлена, иначе имя ошибки; timeoutMs=0 — без таймаута
+    virtual const char* submit(Pipe p, uint8_t ep, uint8_t* buf, size_t n, unsigned timeoutMs) = 0;
+    virtual void cancel(Pipe p) = 0;
+    virtual bool onEventThread() const = 0;
+
+protected:
+    Sink* sink_ = nullptr;
+};
+
+} // namespace smartio
+
+#endif // TRANSPORT_H
@@ -0,0 +1,132 @@
+#include "usbcontext.h"
+#include <cstring>
+#include <sstream>
+
+namespace smartio {
+
+namespace {
+std::mutex layoutsM;
+std::map<std::string, InterfaceLayout> layouts;     // по пути + VID:PID + интерфейсу
+}
+
+std::shared_ptr<UsbContext> UsbContext::instance(){
+    static std::mutex m;
+    static std::weak_ptr<UsbContext> weak;
+    std::lock_guard<std::mutex> lk(m);
+    auto p = weak.lock();
+    if (!p) {
+        // последний ридер мог быть освобождён из callback'а в потоке событий:
+        // тогда контекст разбирается в отдельном потоке, после выхода из цикла событий
+        p.reset(new UsbContext(), [](UsbContext* c){
+            if (c->onEventThread()) std::thread([c]{ delete c; }).detach();
+            else delete c;
+        });
+        weak = p;
+    }
+    return p;
+}
+
+UsbContext::UsbContext(){
+    if (int r = libusb_init(&ctx_); r != 0) {
+        std::ostringstream os; os<<"libusb("<<r<<"): "<<libusb_error_name(r);
+        throw ReaderError(os.str());
+    }
+    libusb_set_option(ctx_, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_NONE);
+    // ENUMERATE: уже подключённые устройства приходят сразу, из этого вызова
+    hasHotplug_ = libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG) &&
+        libusb_hotplug_register_callback(ctx_,
+            (libusb_hotplug_event)(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+            LIBUSB_HOTPLUG_ENUMERATE, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+            LIBUSB_HOTPLUG_MATCH_ANY, &UsbContext::onHotplug, this, &hotplug_) == LIBUSB_SUCCESS;
+    evThread_ = std::thread([this]{ eventLoop(); });
+}
+
+UsbContext::~UsbContext(){
+    if (hasHotplug_) libusb_hotplug_deregister_callback(ctx_, hotplug_);
+    stop_ = true;
+    libusb_interrupt_event_handler(ctx_);
+    if (evThread_.joinable()) evThread_.join();
+    table_.clear();
+    libusb_exit(ctx_);
+}
+
+void UsbContext::eventLoop(){
+    while (!stop_) {
+        timeval tv{0, 200000};
+        libusb_handle_events_timeout_completed(ctx_, &tv, nullptr);
+    }
+}
+
+// Вызывается под m_ или из hotplug (он берёт m_ сам).
+void UsbContext::add(libusb_device* d){
+    UsbDevice u;
+    if (libusb_get_device_descriptor(d, &u.dd) != 0) return;
+    u.dev = DeviceRef(d);
+    u.loc.vid = u.dd.idVendor; u.loc.pid = u.dd.idProduct;
+    u.loc.bus = libusb_get_bus_number(d);
+    u.loc.address = libusb_get_device_address(d);
+    const int np = libusb_get_port_numbers(d, u.loc.ports, (int)sizeof(u.loc.ports));
+    u.loc.portCount = np > 0 ? (uint8_t)np : 0;
+    table_[readerPath(u.loc)] = std::move(u);
+}
+
+void UsbContext::rescan(){
+    libusb_device** list = nullptr;
+    const ssize_t n = libusb_get_device_list(ctx_, &list);
+    if (n < 0) throw ReaderError("libusb_get_device_list завершилась ошибкой");
+    std::map<std::string, UsbDevice> old;
+    old.swap(table_);
+    for (ssize_t i=0; i<n; ++i) add(list[i]);
+    // серийные номера уже прочитанных устройств сохраняются
+    for (auto& [path, u] : table_) {
+        auto it = old.find(path);
+        if (it != old.end() && it->second.dev.get() == u.dev.get() && it->second.serialKnown) {
+            std::memcpy(u.loc.serial, it->second.loc.serial, sizeof(u.loc.serial));
+            u.serialKnown = true;
+        }
+    }
+    libusb_free_device_list(list, 1);
+}
+
+std::vector<UsbDevice> UsbContext::devices(uint16_t vid, uint16_t pid){
+    std::lock_guard<std::mutex> lk(m_);
+    if (!hasHotplug_) rescan();
+    std::vector<UsbDevice> out;
+    for (const auto& [path, u] : table_)
+        if ((!vid || u.dd.idVendor == vid) && (!pid || u.dd.idProduct == pid)) out.push_back(u);
+    return out;
+}
+
+void UsbContext::rememberSerial(const std::string& path, const char* serial){
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = table_.find(path);
+    if (it == table_.end()) return;
+    std::strncpy(it->second.loc.serial, serial, sizeof(it->second.loc.serial) - 1);
+    it->second.serialKnown = true;
+}
+
+std::optional<InterfaceLayout> UsbContext::layout(const std::string& key){
+    std::lock_guard<std::mutex> lk(layoutsM);
+    auto it = layouts.find(key);
+    if (it == layouts.end()) return std::nullopt;
+    return it->second;
+}
+
+void UsbContext::storeLayout(const std::string& key, const InterfaceLayout& l){
+    std::lock_guard<std::mutex> lk(layoutsM);
+    layouts[key] = l;
+}
+
+int LIBUSB_CALL UsbContext::onHotplug(libusb_context*, libusb_device* d, libusb_hotplug_event ev, void* user){
+    auto* self = static_cast<UsbContext*>(user);
+    std::lock_guard<std::mutex> lk(self->m_);
+    if (ev == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+        self->add(d);
+    } else {
+        for (auto it = self->table_.begin(); it != self->table_.end(); ++it)
+            if (it->second.dev.get() == d) { self->table_.erase(it); break; }
+    }
+    return 0;
+}
+
+} // namespace smartio
@@ -0,0 +1,93 @@
+#ifndef USBCONTEXT_H
+#define USBCONTEXT_H
+
+#pragma once
+#include "ReaderApi.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <libusb-1.0/libusb.h>
+
+namespace smartio {
+
+// Ссылка на libusb_device с подсчётом ссылок libusb.
+class DeviceRef {
+public:
+    DeviceRef() = default;
+    explicit DeviceRef(libusb_device* d) : d_(d ? libusb_ref_device(d) : nullptr) {}
+    DeviceRef(const DeviceRef& o) : DeviceRef(o.d_) {}
+    DeviceRef(DeviceRef&& o) noexcept : d_(o.d_) { o.d_ = nullptr; }
+    DeviceRef& operator=(DeviceRef o) noexcept { std::swap(d_, o.d_); return *this; }
+    ~DeviceRef() { if (d_) libusb_unref_device(d_); }
+    libusb_device* get() const { return d_; }
+private:
+    libusb_device* d_ = nullptr;
+};
+
+// Разобранный интерфейс ридера: конечные точки и дескриптор CCID.
+struct InterfaceLayout {
+    int ifNum = -1;
+    bool ccid = false;
+    uint8_t epIn = 0, epOut = 0;
+    std::optional<uint8_t> epIntr;
+    uint16_t inMaxPacket = 64;
+    CcidDescriptor desc;
+};
+
+struct UsbDevice {
+    DeviceRef dev;
+    libusb_device_descriptor dd{};
+    ReaderLocation loc{};
+    bool serialKnown = false;
+};
+
+// Общий на процесс контекст libusb. Держит единственный поток событий,
+// таблицу подключённых устройств (по hotplug, без повторных обходов шины)
+// и кэш разобранных интерфейсов по пути на шине: повторное открытие и
+// переподключение в тот же порт обходятся без чтения дескрипторов.
+// Кэш интерфейсов общий на процесс и переживает закрытие последнего ридера.
+class UsbContext {
+public:
+    static std::shared_ptr<UsbContext> instance();
+    ~UsbContext();
+
+    UsbContext(const UsbContext&) = delete;
+    UsbContext& operator=(const UsbContext&) = delete;
+
+    libusb_context* ctx() const { return ctx_; }
+    bool onEventThread() const { return std::this_thread::get_id() == evThread_.get_id(); }
+
+    std::vector<UsbDevice> devices(uint16_t vid, uint16_t pid);
+    void rememberSerial(const std::string& path, const char* serial);
+
+    std::optional<InterfaceLayout> layout(const std::string& key);
+    void storeLayout(const std::string& key, const InterfaceLayout& l);
+
+private:
+    UsbContext();
+
+    libusb_context* ctx_ = nullptr;
+    std::thread evThread_;
+    std::atomic<bool> stop_{false};
+    libusb_hotplug_callback_handle hotplug_{};
+    bool hasHotplug_ = false;
+
+    std::mutex m_;
+    std::map<std::string, UsbDevice> table_;           // по readerPath
+
+    void eventLoop();
+    void add(libusb_device* d);
+    void rescan();
+
+    static int LIBUSB_CALL onHotplug(libusb_context* ctx, libusb_device* d,
+                                     libusb_hotplug_event ev, void* user);
+};
+
+} // namespace smartio
+
+#endif // USBCONTEXT_H
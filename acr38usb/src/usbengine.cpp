@@ -0,0 +1,374 @@
+#include "usbengine.h"
+#include "ReaderApi.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+namespace smartio {
+namespace {
+constexpr size_t CCID_HDR_LEN = 10;
+constexpr size_t ACS_HDR_LEN  = 4;
+constexpr int    MAX_EMPTY_IN = 5;
+constexpr int    MAX_INTR_ERRORS = 8;   // подряд, до остановки слушателя interrupt IN
+
+constexpr uint8_t XFER_INTR = 1;
+constexpr uint8_t XFER_BULK = 3;
+
+// статус передачи в терминах usbmon (-errno)
+int32_t usbmonStatus(XferStatus st){
+    switch (st){
+    case XferStatus::Completed: return 0;
+    case XferStatus::TimedOut:  return -110;   // ETIMEDOUT
+    case XferStatus::Cancelled: return -2;     // ENOENT
+    case XferStatus::Stall:     return -32;    // EPIPE
+    case XferStatus::NoDevice:  return -19;    // ENODEV
+    case XferStatus::Overflow:  return -75;    // EOVERFLOW
+    default:                    return -71;    // EPROTO
+    }
+}
+
+const char* tag(Framing f){ return f==Framing::CCID ? "CCID" : "ACS"; }
+
+StatOp statOp(Framing f, const Frame& out){
+    if (f == Framing::CCID) {
+        switch (out[0]) {
+        case 0x62: return StatOp::IccPowerOn;
+        case 0x63: return StatOp::IccPowerOff;
+        case 0x65: return StatOp::GetSlotStatus;
+        case 0x61: return StatOp::SetParameters;
+        default:   return StatOp::XfrBlock;
+        }
+    }
+    if (out[1] == 0xA0) return StatOp::AcsExchangeT0;
+    if (out[1] == 0xA1) return StatOp::AcsExchangeT1;
+    return StatOp::AcsOther;
+}
+
+std::string xferErr(XferStatus st){
+    std::ostringstream os; os<<"transfer status "<<int(st);
+    switch (st){
+    case XferStatus::Error:     os<<" (ERROR)"; break;
+    case XferStatus::TimedOut:  os<<" (TIMED_OUT)"; break;
+    case XferStatus::Cancelled: os<<" (CANCELLED)"; break;
+    case XferStatus::Stall:     os<<" (STALL)"; break;
+    case XferStatus::NoDevice:  os<<" (NO_DEVICE)"; break;
+    case XferStatus::Overflow:  os<<" (OVERFLOW)"; break;
+    default: break;
+    }
+    return os.str();
+}
+}
+
+UsbEngine::UsbEngine(std::unique_ptr<UsbTransport> io) : io_(std::move(io)) {
+    io_->bind(this);
+}
+
+UsbEngine::~UsbEngine() {
+    detach();
+}
+
+void UsbEngine::attach(uint8_t epOut, uint8_t epIn, FramePool* pool,
+                       ReaderMetrics* metrics, TraceRing* trace){
+    std::lock_guard<std::mutex> lk(m_);
+    attached_ = true; epOut_ = epOut; epIn_ = epIn; pool_ = pool; metrics_ = metrics; trace_ = trace;
+}
+
+void UsbEngine::detach(){
+    std::unique_lock<std::mutex> lk(m_);
+    attached_ = false; held_ = false;
+    while (!queue_.empty()) {
+        auto done = std::move(queue_.front().done);
+        queue_.pop_front();
+        auto err = std::make_exception_ptr(ReaderError("Ридер закрыт, обмен отменён"));
+        if (done) deferred_.push_back({std::move(done), Frame{}, err});
+    }
+    if (busy_) {
+        if (outPending_) io_->cancel(Pipe::Out);
+        if (inPending_)  io_->cancel(Pipe::In);
+    }
+    if (intrPending_) io_->cancel(Pipe::Intr);
+    // из callback'а в потоке событий ждать нельзя: завершения доставляет этот же поток.
+    // Отменённые передачи завершатся после выхода из callback'а и увидят attached_ == false.
+    if (!onEventThread()) idle_.wait(lk, [this]{ return !busy_ && !intrPending_; });
+    onIntr_ = nullptr;
+    flush(lk);
+}
+
+void UsbEngine::whenIdle(std::function<void()> f){
+    std::unique_lock<std::mutex> lk(m_);
+    idleCb_ = std::move(f);
+    runIdle(lk);
+}
+
+void UsbEngine::runIdle(std::unique_lock<std::mutex>& lk){
+    if (!idleCb_ || busy_ || intrPending_) return;
+    auto f = std::move(idleCb_);
+    idleCb_ = nullptr;
+    lk.unlock();
+    f();
+    lk.lock();
+}
+
+void UsbEngine::listen(uint8_t epIntr, IntrCallback cb){
+    std::lock_guard<std::mutex> lk(m_);
+    if (!attached_) throw ReaderError("Закрытый");
+    if (intrPending_) throw ReaderError("Interrupt IN уже слушается");
+    epIntr_ = epIntr;
+    onIntr_ = std::move(cb);
+    intrErrors_ = 0;
+    if (!submitIntr()) throw ReaderError("Не удалось выставить передачу interrupt IN");
+}
+
+bool UsbEngine::submitIntr(){
+    // без таймаута: уведомление может прийти через сколь угодно долгое время
+    if (io_->submit(Pipe::Intr, epIntr_, intrBuf_, sizeof(intrBuf_), 0)) return false;
+    intrPending_ = true;
+    return true;
+}
+
+void UsbEngine::submit(UsbExchange ex, bool front){
+    std::unique_lock<std::mutex> lk(m_);
+    if (!attached_) throw ReaderError("Закрытый");
+    if (front) { queue_.push_front(std::move(ex)); held_ = false; }
+    else queue_.push_back(std::move(ex));
+    startNext();
+    flush(lk);
+}
+
+void UsbEngine::release(){
+    std::unique_lock<std::mutex> lk(m_);
+    held_ = false;
+    startNext();
+    flush(lk);
+}
+
+Frame UsbEngine::run(UsbExchange ex, bool front){
+    if (onEventThread())
+        throw ReaderError("Синхронный обмен из потока событий USB невозможен");
+    // ожидание на стеке: callback захватывает один указатель и не аллоцирует
+    struct Waiter {
+        std::mutex m; std::condition_variable cv; bool ready = false;
+        Frame resp; std::exception_ptr err;
+    } w;
+    ex.done = [&w](Frame&& resp, std::exception_ptr err){
+        std::lock_guard<std::mutex> lk(w.m);
+        w.resp = std::move(resp); w.err = err; w.ready = true;
+        w.cv.notify_one();
+    };
+    submit(std::move(ex), front);
+    std::unique_lock<std::mutex> lk(w.m);
+    w.cv.wait(lk, [&w]{ return w.ready; });
+    if (w.err) std::rethrow_exception(w.err);
+    return std::move(w.resp);
+}
+
+size_t UsbEngine::need() const {
+    if (cur_.framing == Framing::CCID) {
+        if (got_ < CCID_HDR_LEN) return CCID_HDR_LEN;
+        const uint8_t* p = in_.data();
+        return CCID_HDR_LEN + ((size_t)p[1] | ((size_t)p[2]<<8) | ((size_t)p[3]<<16) | ((size_t)p[4]<<24));
+    }
+    if (got_ < ACS_HDR_LEN) return ACS_HDR_LEN;
+    return ACS_HDR_LEN + ((size_t(in_[2])<<8) | in_[3]);
+}
+
+bool UsbEngine::complete() const {
+    const size_t hdr = (cur_.framing == Framing::CCID) ? CCID_HDR_LEN : ACS_HDR_LEN;
+    return got_ >= hdr && got_ >= need();
+}
+
+void UsbEngine::fail(const std::string& what){
+    if (!err_) err_ = std::make_exception_ptr(ReaderError(std::string(tag(cur_.framing)) + ": " + what));
+}
+
+void UsbEngine::startNext(){
+    while (!busy_ && !held_ && attached_ && !queue_.empty()) {
+        cur_ = std::move(queue_.front());
+        queue_.pop_front();
+        busy_ = true; got_ = 0; emptyReads_ = 0; err_ = nullptr; errStatus_ = 0;
+        ++urb_;
+        in_ = pool_->acquire();
+        started_ = ReaderMetrics::Clock::now();
+        deadline_ = cur_.timeoutMs ? started_ + std::chrono::milliseconds(cur_.timeoutMs)
+                                   : ReaderMetrics::Clock::time_point::max();
+
+        if (const char* e = io_->submit(Pipe::Out, epOut_, cur_.out.data(), cur_.out.size(), cur_.timeoutMs)) {
+            fail(std::string("ошибка передачи Bulk OUT: ") + e);
+            maybeFinish();
+            continue;
+        }
+        outPending_ = true;
+        if (trace_) trace_->record(urb_, TraceRing::Kind::Submit, XFER_BULK, epOut_, cur_.out.data(), cur_.out.size());
+        // IN выставляется сразу, не дожидаясь завершения OUT
+        submitIn();
+    }
+}
+
+void UsbEngine::submitIn(){
+    // таймаут передачи — остаток до крайнего срока обмена, не меньше 1 мс
+    unsigned timeoutMs = 0;
+    if (deadline_ != ReaderMetrics::Clock::time_point::max()) {
+        const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline_ - ReaderMetrics::Clock::now()).count();
+        if (left <= 0) {
+            if (metrics_) metrics_->timeouts.fetch_add(1, std::memory_order_relaxed);
+            fail(got_ ? "неполный ответ" : "отсутствует/неполный заголовок");
+            if (outPending_) io_->cancel(Pipe::Out);
+            return;
+        }
+        timeoutMs = (unsigned)left;
+    }
+    if (need() > in_.capacity()) {
+        // ответ длиннее кадра пула (редкий случай): переносим принятое в больший буфер
+        const size_t unit = pool_->frameSize() ? pool_->frameSize() : 1;
+        Frame big = pool_->acquire((need() + unit - 1) / unit * unit);
+        if (got_) std::memcpy(big.data(), in_.data(), got_);
+        in_ = std::move(big);
+    }
+    in_.resize(in_.capacity());
+
+    if (const char* e = io_->submit(Pipe::In, epIn_, in_.data() + got_, in_.capacity() - got_, timeoutMs)) {
+        fail(std::string("ошибка приёма Bulk IN: ") + e);
+        if (outPending_) io_->cancel(Pipe::Out);
+        return;
+    }
+    inPending_ = true;
+}
+
+// Промежуточный ответ CCID «карте нужно больше времени»: кадр отбрасывается,
+// срок сдвигается, окончательный ответ читается в тот же буфер.
+bool UsbEngine::timeExtension(){
+    if (cur_.framing != Framing::CCID || !complete() || (in_[7] & 0xC0) != 0x80) return false;
+    const unsigned mult = in_[8] ? in_[8] : 1;
+    if (deadline_ != ReaderMetrics::Clock::time_point::max())
+        deadline_ = std::max(deadline_, ReaderMetrics::Clock::now() + std::chrono::milliseconds((uint64_t)cur_.timeoutMs * mult));
+    if (metrics_) metrics_->timeExtensions.fetch_add(1, std::memory_order_relaxed);
+    const size_t n = need();
+    if (got_ > n) std::memmove(in_.data(), in_.data() + n, got_ - n);
+    got_ -= n;
+    emptyReads_ = 0;
+    return true;
+}
+
+void UsbEngine::maybeFinish(){
+    if (!busy_ || outPending_ || inPending_) return;
+    Completion c{std::move(cur_.done), Frame{}, err_};
+    if (trace_) {
+        if (err_) trace_->record(urb_, TraceRing::Kind::Error, XFER_BULK, epIn_, nullptr, 0, errStatus_ ? errStatus_ : -71);
+        else trace_->record(urb_, TraceRing::Kind::Complete, XFER_BULK, epIn_, in_.data(), need());
+    }
+    if (metrics_) {
+        if (err_) metrics_->errors.fetch_add(1, std::memory_order_relaxed);
+        else metrics_->exchange(statOp(cur_.framing, cur_.out), started_, cur_.out.size(), need());
+    }
+    if (!err_) {
+        in_.resize(need());
+        held_ = cur_.hold && cur_.hold(in_);
+        c.resp = std::move(in_);
+    }
+    cur_.hold = nullptr;
+    in_ = Frame{};
+    cur_.out = Frame{};
+    busy_ = false; err_ = nullptr;
+    if (c.done) deferred_.push_back(std::move(c));
+    startNext();
+    idle_.notify_all();
+}
+
+void UsbEngine::flush(std::unique_lock<std::mutex>& lk){
+    while (!deferred_.empty()) {
+        std::vector<Completion> calls;
+        calls.swap(deferred_);
+        lk.unlock();
+        for (auto& c : calls) c.done(std::move(c.resp), c.err);
+        calls.clear();
+        lk.lock();
+    }
+}
+
+void UsbEngine::transferDone(Pipe p, XferStatus st, size_t actual){
+    switch (p) {
+    case Pipe::Out:  onOut(st, actual); break;
+    case Pipe::In:   onIn(st, actual); break;
+    case Pipe::Intr: onIntr(st, actual); break;
+    }
+}
+
+void UsbEngine::onOut(XferStatus st, size_t actual){
+    std::unique_lock<std::mutex> lk(m_);
+    outPending_ = false;
+    if (st != XferStatus::Completed || actual != cur_.out.size()) {
+        if (!errStatus_) errStatus_ = usbmonStatus(st);
+        fail("ошибка передачи Bulk OUT: " + xferErr(st));
+        if (inPending_) io_->cancel(Pipe::In);
+    }
+    maybeFinish();
+    flush(lk);
+    runIdle(lk);
+}
+
+void UsbEngine::onIn(XferStatus st, size_t actual){
+    std::unique_lock<std::mutex> lk(m_);
+    inPending_ = false;
+    got_ += actual;
+    if (st != XferStatus::Completed && !errStatus_) errStatus_ = usbmonStatus(st);
+
+    if (st == XferStatus::Completed) {
+        bool extended = false;
+        while (!err_ && attached_ && timeExtension()) extended = true;
+        if (extended) {
+            if (!complete()) submitIn();
+        } else if (!complete() && !err_) {
+            if (!attached_) fail("обмен отменён");
+            else if (actual == 0 && ++emptyReads_ >= MAX_EMPTY_IN)
+                fail("отсутствует/неполный заголовок");
+            else {
+                if (metrics_)
+                    (actual ? metrics_->partialIn : metrics_->retries).fetch_add(1, std::memory_order_relaxed);
+                submitIn();
+            }
+        }
+    } else if (st == XferStatus::TimedOut && !complete()) {
+        if (metrics_) metrics_->timeouts.fetch_add(1, std::memory_order_relaxed);
+        const size_t hdr = (cur_.framing == Framing::CCID) ? CCID_HDR_LEN : ACS_HDR_LEN;
+        fail(got_ < hdr ? "отсутствует/неполный заголовок" : "неполный ответ");
+    } else if (st == XferStatus::Cancelled) {
+        fail("обмен отменён");
+    } else if (st != XferStatus::TimedOut) {
+        fail("ошибка приёма Bulk IN: " + xferErr(st));
+    }
+    if (err_ && outPending_) io_->cancel(Pipe::Out);
+    maybeFinish();
+    flush(lk);
+    runIdle(lk);
+}
+
+void UsbEngine::onIntr(XferStatus st, size_t actual){
+    // intrPending_ остаётся true до конца callback: detach() дождётся его выхода
+    IntrCallback cb;
+    uint8_t buf[sizeof(intrBuf_)];
+    const size_t n = st == XferStatus::Completed ? actual : 0;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        cb = onIntr_;
+        std::memcpy(buf, intrBuf_, n);
+        if (n && trace_)
+            trace_->record(++intrUrb_, TraceRing::Kind::Complete, XFER_INTR, epIntr_, buf, n);
+    }
+    if (cb && n) cb(buf, n);
+
+    std::unique_lock<std::mutex> lk(m_);
+    // устойчивая ошибка (Error, Overflow…) не должна крутить перевыставление в потоке событий
+    intrErrors_ = st == XferStatus::Completed ? 0 : intrErrors_ + 1;
+    const bool retry = attached_ && st != XferStatus::Cancelled
+                    && st != XferStatus::NoDevice && st != XferStatus::Stall
+                    && intrErrors_ < MAX_INTR_ERRORS;
+    if (retry && submitIntr()) return;
+    // отмена при detach — штатная остановка, о ней не сообщаем
+    if (cb && attached_ && st != XferStatus::Cancelled) { lk.unlock(); cb(nullptr, 0); lk.lock(); }
+    intrPending_ = false;
+    idle_.notify_all();
+    runIdle(lk);
+}
+
+} // namespace smartio
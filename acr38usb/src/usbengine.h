@@ -0,0 +1,127 @@
+#ifndef USBENGINE_H
+#define USBENGINE_H
+
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "framepool.h"
+#include "metrics.h"
+#include "tracering.h"
+#include "transport.h"
+
+namespace smartio {
+
+enum class Framing { CCID, ACS };
+
+// Один обмен «команда → ответ» по паре Bulk OUT/IN.
+struct UsbExchange {
+    Framing framing = Framing::CCID;
+    Frame out;
+    unsigned timeoutMs = 2000;
+    std::function<void(Frame&& resp, std::exception_ptr err)> done;
+    // true — ответ открывает цепочку: очередь придерживается до продолжения
+    std::function<bool(const Frame& resp)> hold;
+};
+
+// Асинхронный движок обменов поверх UsbTransport (libusb или стендовый в памяти);
+// события обрабатывает поток транспорта.
+// Обмены ставятся в очередь и выполняются строго по одному; Bulk IN
+// выставляется сразу вслед за Bulk OUT, следующий OUT уходит из callback
+// завершения предыдущего ответа. Callback'и вызываются из потока событий.
+// Ответ читается прямо в кадр из пула ридера и отдаётся вызывающему без копий.
+// У обмена один крайний срок timeoutMs от выставления OUT на все чтения Bulk IN;
+// ответ CCID с запросом продления (bStatus 0x80, bError — множитель) сдвигает
+// его на timeoutMs * bError и ожидание продолжается.
+// Многокадровые последовательности (цепочки CCID) не перемежаются чужими
+// обменами: после ответа с hold()==true очередь стоит до submit(..., front=true)
+// или release().
+// Interrupt IN слушается отдельно: передача держится выставленной постоянно,
+// каждое уведомление уходит в callback listen() из потока событий.
+class UsbEngine : private UsbTransport::Sink {
+public:
+    explicit UsbEngine(std::unique_ptr<UsbTransport> io);
+    ~UsbEngine();
+
+    UsbEngine(const UsbEngine&) = delete;
+    UsbEngine& operator=(const UsbEngine&) = delete;
+
+    void attach(uint8_t epOut, uint8_t epIn, FramePool* pool,
+                ReaderMetrics* metrics = nullptr, TraceRing* trace = nullptr);
+    void detach();
+    // f — когда выставленных передач не останется: сразу или из последнего завершения
+    // (после detach() в потоке событий, где ждать их нельзя).
+    void whenIdle(std::function<void()> f);
+
+    void submit(UsbExchange ex, bool front = false);
+    Frame run(UsbExchange ex, bool front = false);
+    void release();
+    // data==nullptr — слушатель остановлен ошибкой конечной точки
+    using IntrCallback = std::function<void(const uint8_t* data, size_t n)>;
+    void listen(uint8_t epIntr, IntrCallback cb);
+    bool onEventThread() const { return io_->onEventThread(); }
+    UsbTransport& transport() { return *io_; }
+
+private:
+    std::unique_ptr<UsbTransport> io_;
+    bool attached_ = false;
+    uint8_t epOut_ = 0, epIn_ = 0;
+    FramePool* pool_ = nullptr;
+    ReaderMetrics* metrics_ = nullptr;
+    ReaderMetrics::Clock::time_point started_, deadline_;
+    TraceRing* trace_ = nullptr;
+    uint64_t urb_ = 0;          // номер обмена в трассе: Submit и Complete/Error парные
+    uint64_t intrUrb_ = 1ull << 63;  // interrupt IN — своя последовательность, не сбивает urb_
+    int32_t errStatus_ = 0;     // статус usbmon (-errno) для записи Error
+
+    std::mutex m_;
+    std::condition_variable idle_;
+    std::deque<UsbExchange> queue_;
+
+    bool busy_ = false, outPending_ = false, inPending_ = false, held_ = false;
+    UsbExchange cur_;
+    Frame in_;
+    size_t got_ = 0;
+    int emptyReads_ = 0;
+    std::exception_ptr err_;
+
+    struct Completion {
+        std::function<void(Frame&&, std::exception_ptr)> done;
+        Frame resp;
+        std::exception_ptr err;
+    };
+    std::vector<Completion> deferred_;
+
+    uint8_t epIntr_ = 0;
+    uint8_t intrBuf_[64];
+    bool intrPending_ = false;
+    int intrErrors_ = 0;
+    IntrCallback onIntr_;
+    std::function<void()> idleCb_;
+
+    void startNext();
+    void submitIn();
+    bool timeExtension();
+    void fail(const std::string& what);
+    void maybeFinish();
+    void flush(std::unique_lock<std::mutex>& lk);
+    bool complete() const;
+    size_t need() const;
+    bool submitIntr();
+    void runIdle(std::unique_lock<std::mutex>& lk);
+
+    void transferDone(Pipe p, XferStatus st, size_t actual) override;
+    void onOut(XferStatus st, size_t actual);
+    void onIn(XferStatus st, size_t actual);
+    void onIntr(XferStatus st, size_t actual);
+};
+
+} // namespace smartio
+
+#endif // USBENGINE_H
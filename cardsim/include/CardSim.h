@@ -0,0 +1,37 @@
+#ifndef CARDSIM_H
+#define CARDSIM_H
+#pragma once
+#include "ReaderApi.h"
+
+namespace smartio {
+
+// Настройки симулятора карты (библиотека cardsim). POD: передаётся через C-интерфейс.
+// Время APDU = apduUs + байты * byteUs + байты * 12 etu / baud (старт, 8 бит,
+// чётность, 2 etu защитного интервала), байты — команда плюс ответ.
+struct CardSimConfig {
+    const char* layoutPath;     // JSON-разметка РИК-2 (Rik2Parser)
+    uint32_t apduUs;            // накладные расходы ридера на APDU
+    uint32_t byteUs;            // дополнительная цена байта
+    uint32_t baud;              // скорость карты, бит/с (0 — линия не учитывается)
+    int realtime;               // 1 — спать, 0 — только виртуальные часы (stats, cardsim_elapsed_us)
+    int blank;                  // 1 — EF с createApdus отсутствуют до CREATE FILE (новая карта)
+    int extendedLength;         // ATR объявляет расширенные Lc/Le
+    uint64_t serial;            // серийный номер карты, 0 — очередной по счётчику
+};
+
+inline CardSimConfig cardSimDefaults(){
+    return CardSimConfig{nullptr, 1000, 0, 9600, 1, 0, 0, 0};
+}
+
+} // namespace smartio
+
+extern "C" {
+// Применяется при следующем open(). Без вызова — переменные окружения
+// SMARTIO_SIM_LAYOUT, SMARTIO_SIM_APDU_US, SMARTIO_SIM_BYTE_US, SMARTIO_SIM_BAUD,
+// SMARTIO_SIM_REALTIME, SMARTIO_SIM_BLANK, SMARTIO_SIM_EXTENDED.
+READER_API int      cardsim_configure(smartio::ICardReader* r, const smartio::CardSimConfig* cfg);
+// Суммарное модельное время обменов с open(), мкс.
+READER_API uint64_t cardsim_elapsed_us(smartio::ICardReader* r);
+}
+
+#endif // CARDSIM_H
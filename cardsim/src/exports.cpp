@@ -0,0 +1,72 @@
+#include "ReaderApi.h"
+#include "CardSim.h"
+#include "simreader.h"
+#include <cstring>
+
+using namespace smartio;
+
+static thread_local char g_lastError[256];
+
+static int fail(int code, const char* what){
+    std::strncpy(g_lastError, what, sizeof(g_lastError) - 1);
+    return code;
+}
+
+extern "C" {
+
+READER_API ICardReader* create_reader() {
+    try { return new SimReader(); }
+    catch (...) { return nullptr; }
+}
+
+READER_API void destroy_reader(ICardReader* p) {
+    delete p;
+}
+
+READER_API const char* reader_library_version() {
+    return "cardsim 0.4";
+}
+
+// Виртуальный ридер один и не зависит от vid:pid.
+READER_API size_t enumerate_readers(uint16_t vid, uint16_t pid, ReaderLocation* out, size_t cap) {
+    if (out && cap) {
+        std::memset(out, 0, sizeof(*out));
+        out->vid = vid; out->pid = pid;
+        std::strncpy(out->serial, "cardsim", sizeof(out->serial) - 1);
+    }
+    return 1;
+}
+
+READER_API int reader_transmit_into(ICardReader* r, const uint8_t* capdu, size_t len,
+                                   uint8_t* rapdu, size_t cap, size_t* outLen, unsigned timeoutMs) {
+    (void)timeoutMs;
+    if (!r || !capdu || !rapdu || !outLen) return fail(READER_E_ARGS, "Нулевой указатель в аргументах");
+    *outLen = 0;
+    try {
+        const size_t n = static_cast<SimReader*>(r)->transmitInto(capdu, len, rapdu, cap);
+        if (n > cap) return fail(READER_E_BUFFER, "Ответ длиннее буфера вызывающего");
+        *outLen = n;
+        g_lastError[0] = 0;
+        return READER_OK;
+    } catch (const std::exception& e) {
+        return fail(READER_E_READER, e.what());
+    } catch (...) {
+        return fail(READER_E_READER, "Неизвестная ошибка");
+    }
+}
+
+READER_API const char* reader_last_error() {
+    return g_lastError;
+}
+
+READER_API int cardsim_configure(ICardReader* r, const CardSimConfig* cfg) {
+    if (!r || !cfg) return fail(READER_E_ARGS, "Нулевой указатель в аргументах");
+    static_cast<SimReader*>(r)->configure(*cfg);
+    return READER_OK;
+}
+
+READER_API uint64_t cardsim_elapsed_us(ICardReader* r) {
+    return r ? static_cast<SimReader*>(r)->elapsedUs() : 0;
+}
+
+}
@@ -0,0 +1,359 @@
+#include "simcard.h"
+#include "Atr.h"
+#include "Hex.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace smartio {
+
+static std::vector<uint8_t> sw(uint16_t s){
+    return {uint8_t(s>>8), uint8_t(s)};
+}
+static std::vector<uint8_t> withSw(std::vector<uint8_t> d, uint16_t s){
+    d.push_back(uint8_t(s>>8));
+    d.push_back(uint8_t(s));
+    return d;
+}
+static bool isRecords(const SimFile* f){
+    return f && (f->type==EfType::LinearFixed || f->type==EfType::Cyclic);
+}
+
+SimFile* SimFile::child(uint16_t f) const {
+    for (auto& c : children) if (c->fid == f) return c.get();
+    return nullptr;
+}
+
+SimCard::SimCard(std::shared_ptr<const Rik2Layout> layout, uint64_t serial, bool blank, bool extendedLength)
+    : layout_(std::move(layout)), extended_(extendedLength) {
+    mf_ = build(*layout_->root, nullptr, blank);
+    if (layout_->atrExpected && !layout_->atrExpected->isEmpty()) {
+        atr_ = hexToBytes(layout_->atrExpected->toStdString());
+        extended_ = parseAtr(atr_).extendedLength;
+    } else {
+        // T=0, историческая часть: категория 80, возможности карты 73 00 00 xx
+        atr_ = {0x3B, 0x05, 0x80, 0x73, 0x00, 0x00, uint8_t(extended_ ? 0xC0 : 0x80)};
+    }
+    fillSerial(serial);
+    reset();
+}
+
+std::unique_ptr<SimFile> SimCard::build(const Node& n, SimFile* parent, bool blank){
+    if (blank && n.type!=EfType::DF && !n.createApdus.empty()) return nullptr;
+    auto f = std::make_unique<SimFile>();
+    f->fid = n.fid;
+    f->sfi = n.sfi ? (uint8_t)n.sfi : uint8_t(n.fid & 0x1F);
+    f->type = n.type;
+    f->layout = &n;
+    f->parent = parent;
+    f->recordSize = n.recordSize;
+    f->recordCount = n.recordCount;
+    if (n.type==EfType::Transparent) f->data.assign((size_t)n.size, 0x00);
+    else if (isRecords(f.get())) f->data.assign((size_t)n.recordSize * n.recordCount, 0x00);
+    for (auto& ch : n.children)
+        if (auto c = build(*ch, f.get(), blank)) f->children.push_back(std::move(c));
+    return f;
+}
+
+void SimCard::fillSerial(uint64_t serial){
+    for (int i=7; i>=0; --i) serial_.push_back(uint8_t(serial >> (8*i)));
+    const auto& s = layout_->serial;
+    if (!s.apdu.isEmpty()) serialApdu_ = hexToBytes(s.apdu.toStdString());
+    if (s.efPath.empty()) return;
+    SimFile* f = mf_.get();
+    for (auto fid : s.efPath) {
+        if (f == mf_.get() && fid == mf_->fid) continue;
+        if (!(f = f->child(fid))) return;
+    }
+    const size_t n = std::min(f->data.size(), serial_.size());
+    std::memcpy(f->data.data(), serial_.data() + serial_.size() - n, n);
+}
+
+void SimCard::reset(){
+    df_ = mf_.get();
+    ef_ = nullptr;
+    record_ = 0;
+}
+
+void SimCard::enter(SimFile* f){
+    if (f->type==EfType::DF) { df_ = f; ef_ = nullptr; }
+    else { df_ = f->parent; ef_ = f; }
+    record_ = 0;
+}
+
+// Случаи 1–4 ISO/IEC 7816-3, короткие и расширенные Lc/Le; Le=0 — максимум.
+bool SimCard::parse(const uint8_t* a, size_t n, Apdu& c){
+    if (n < 4) return false;
+    c.cla = a[0]; c.ins = a[1]; c.p1 = a[2]; c.p2 = a[3];
+    if (n == 4) return true;
+    if (n == 5) { c.le = a[4] ? a[4] : 256; return true; }
+    if (a[4] != 0) {
+        c.lc = a[4];
+        c.data = a + 5;
+        if (n == 5 + c.lc) return true;
+        if (n == 6 + c.lc) { c.le = a[n-1] ? a[n-1] : 256; return true; }
+        return false;
+    }
+    c.extended = true;
+    const size_t v = (size_t(a[5])<<8) | a[6];
+    if (n == 7) { c.le = v ? v : 65536; return true; }
+    if (!v) return false;
+    c.lc = v;
+    c.data = a + 7;
+    if (n == 7 + c.lc) return true;
+    if (n == 9 + c.lc) { const size_t le = (size_t(a[n-2])<<8) | a[n-1]; c.le = le ? le : 65536; return true; }
+    return false;
+}
+
+std::vector<uint8_t> SimCard::process(const uint8_t* apdu, size_t n){
+    if (!serialApdu_.empty() && n == serialApdu_.size() && std::equal(apdu, apdu + n, serialApdu_.begin()))
+        return withSw(serial_, 0x9000);
+    Apdu c;
+    if (!parse(apdu, n, c)) return sw(0x6700);
+    if (c.cla == 0xFF) return sw(0x6E00);
+    switch (c.ins) {
+    case 0xA4: return select(c);
+    case 0xB0: return readBinary(c);
+    case 0xD6: return updateBinary(c);
+    case 0xB2: return readRecord(c);
+    case 0xDC: return updateRecord(c);
+    case 0xE2: return appendRecord(c);
+    case 0xE0: return createFile(c);
+    default:   return sw(0x6D00);
+    }
+}
+
+SimFile* SimCard::byPath(SimFile* from, const uint8_t* p, size_t n) const {
+    if (!n || n % 2) return nullptr;
+    for (size_t i=0; i<n && from; i+=2) {
+        const uint16_t fid = (uint16_t(p[i])<<8) | p[i+1];
+        if (i == 0 && from == mf_.get() && fid == mf_->fid) continue;
+        from = from->type==EfType::DF ? from->child(fid) : nullptr;
+    }
+    return from;
+}
+
+SimFile* SimCard::efBySfi(uint8_t sfi) const {
+    for (auto& c : df_->children)
+        if (c->type!=EfType::DF && c->sfi == sfi) return c.get();
+    return nullptr;
+}
+
+std::vector<uint8_t> SimCard::select(const Apdu& c){
+    const uint16_t fid = c.lc >= 2 ? uint16_t((c.data[0]<<8) | c.data[1]) : 0;
+    SimFile* f = nullptr;
+    switch (c.p1) {
+    case 0x00:
+        if (!c.lc || fid == mf_->fid) f = mf_.get();
+        else if (c.lc != 2) return sw(0x6700);
+        else if (!(f = df_->child(fid))) {
+            if (df_->fid == fid) f = df_;
+            else if (df_->parent && df_->parent->fid == fid) f = df_->parent;
+            else if (df_->parent) f = df_->parent->child(fid);
+        }
+        break;
+    case 0x01: f = df_->child(fid); if (f && f->type!=EfType::DF) f = nullptr; break;
+    case 0x02: f = df_->child(fid); if (f && f->type==EfType::DF) f = nullptr; break;
+    case 0x03: f = df_->parent; break;
+    case 0x04: break;
+    case 0x08: f = byPath(mf_.get(), c.data, c.lc); break;
+    case 0x09: f = byPath(df_, c.data, c.lc); break;
+    default:   return sw(0x6A86);
+    }
+    if (!f) return sw(0x6A82);
+    enter(f);
+    if ((c.p2 & 0x0C) == 0x0C) return sw(0x9000);
+
+    std::vector<uint8_t> fcp = {0x82, 0x01, 0x38, 0x83, 0x02, uint8_t(f->fid>>8), uint8_t(f->fid)};
+    if (f->type==EfType::Transparent) {
+        fcp[2] = 0x01;
+        fcp.insert(fcp.end(), {0x80, 0x02, uint8_t(f->data.size()>>8), uint8_t(f->data.size())});
+    } else if (isRecords(f)) {
+        fcp.erase(fcp.begin(), fcp.begin()+3);
+        fcp.insert(fcp.begin(), {0x82, 0x05, uint8_t(f->type==EfType::Cyclic ? 0x06 : 0x02), 0x41,
+                                 uint8_t(f->recordSize>>8), uint8_t(f->recordSize), uint8_t(f->recordCount)});
+    }
+    if (f->type!=EfType::DF) fcp.insert(fcp.end(), {0x88, 0x01, uint8_t(f->sfi << 3)});
+    fcp.insert(fcp.begin(), {0x62, uint8_t(fcp.size())});
+    if (c.le && c.le < fcp.size()) fcp.resize(c.le);
+    return withSw(std::move(fcp), 0x9000);
+}
+
+std::vector<uint8_t> SimCard::readBinary(const Apdu& c){
+    size_t off;
+    if (c.p1 & 0x80) {
+        SimFile* f = efBySfi(c.p1 & 0x1F);
+        if (!f) return sw(0x6A82);
+        enter(f);
+        off = c.p2;
+    } else {
+        off = (size_t(c.p1 & 0x7F)<<8) | c.p2;
+    }
+    if (!ef_) return sw(0x6986);
+    if (ef_->type!=EfType::Transparent) return sw(0x6981);
+    if (off > ef_->data.size()) return sw(0x6B00);
+    const size_t n = std::min(c.le, ef_->data.size() - off);
+    std::vector<uint8_t> r(ef_->data.begin()+off, ef_->data.begin()+off+n);
+    return withSw(std::move(r), n < c.le ? 0x6282 : 0x9000);
+}
+
+std::vector<uint8_t> SimCard::updateBinary(const Apdu& c){
+    size_t off;
+    if (c.p1 & 0x80) {
+        SimFile* f = efBySfi(c.p1 & 0x1F);
+        if (!f) return sw(0x6A82);
+        enter(f);
+        off = c.p2;
+    } else {
+        off = (size_t(c.p1 & 0x7F)<<8) | c.p2;
+    }
+    if (!ef_) return sw(0x6986);
+    if (ef_->type!=EfType::Transparent) return sw(0x6981);
+    if (off > ef_->data.size()) return sw(0x6B00);
+    if (off + c.lc > ef_->data.size()) return sw(0x6A84);
+    if (c.lc) std::memcpy(ef_->data.data() + off, c.data, c.lc);
+    return sw(0x9000);
+}
+
+// P2: биты 8–4 — SFI (0 — текущий EF), биты 3–1 — способ адресации записи.
+bool SimCard::recordTarget(const Apdu& c, std::vector<uint8_t>& err){
+    if (const uint8_t sfi = c.p2 >> 3) {
+        SimFile* f = sfi == 0x1F ? nullptr : efBySfi(sfi);
+        if (!f) { err = sw(0x6A82); return false; }
+        if (f != ef_) enter(f);
+    }
+    if (!ef_) { err = sw(0x6986); return false; }
+    if (!isRecords(ef_)) { err = sw(0x6981); return false; }
+    return true;
+}
+
+// Номер записи 1…recordCount; у циклического EF запись 1 — последняя записанная.
+uint8_t* SimCard::record(int no){
+    const int idx = ef_->type==EfType::Cyclic ? (ef_->head + no - 1) % ef_->recordCount : no - 1;
+    return ef_->data.data() + (size_t)idx * ef_->recordSize;
+}
+
+std::vector<uint8_t> SimCard::readRecord(const Apdu& c){
+    std::vector<uint8_t> err;
+    if (!recordTarget(c, err)) return err;
+    const int cnt = ef_->recordCount, rs = ef_->recordSize;
+    const int mode = c.p2 & 0x07;
+    int no = c.p1;
+    switch (mode) {
+    case 0x00: no = 1; break;
+    case 0x01: no = cnt; break;
+    case 0x02: no = record_ + 1; break;
+    case 0x03: no = record_ ? record_ - 1 : cnt; break;
+    case 0x04: case 0x05: case 0x06: if (!no) no = record_; break;
+    default:   return sw(0x6A86);
+    }
+    if (no < 1 || no > cnt) return sw(0x6A83);
+    if (mode == 0x05 || mode == 0x06) {
+        // записи от P1 до последней (05) или от последней до P1 (06), сколько целиком влезет в Le
+        std::vector<uint8_t> r;
+        const size_t max = c.le ? c.le : (c.extended ? 65536 : 256);
+        const int from = mode == 0x05 ? no : cnt, to = mode == 0x05 ? cnt : no, step = mode == 0x05 ? 1 : -1;
+        for (int i=from; r.size() + rs <= max; i+=step) {
+            r.insert(r.end(), record(i), record(i) + rs);
+            record_ = i;
+            if (i == to) break;
+        }
+        if (r.empty()) return sw(0x6700);
+        return withSw(std::move(r), 0x9000);
+    }
+    record_ = no;
+    if (c.le && c.le < (size_t)rs) return sw(rs <= 0xFF ? uint16_t(0x6C00 | rs) : 0x6700);
+    return withSw(std::vector<uint8_t>(record(no), record(no) + rs), 0x9000);
+}
+
+std::vector<uint8_t> SimCard::updateRecord(const Apdu& c){
+    std::vector<uint8_t> err;
+    if (!recordTarget(c, err)) return err;
+    if (c.lc != (size_t)ef_->recordSize) return sw(0x6700);
+    const int mode = c.p2 & 0x07;
+    if (mode == 0x03 && ef_->type==EfType::Cyclic) return appendRecord(c);
+    if (mode != 0x04) return sw(0x6A86);
+    const int no = c.p1 ? c.p1 : record_;
+    if (no < 1 || no > ef_->recordCount) return sw(0x6A83);
+    std::memcpy(record(no), c.data, c.lc);
+    record_ = no;
+    return sw(0x9000);
+}
+
+// Записи линейного EF созданы вместе с файлом, добавлять некуда.
+std::vector<uint8_t> SimCard::appendRecord(const Apdu& c){
+    std::vector<uint8_t> err;
+    if (!recordTarget(c, err)) return err;
+    if (c.lc != (size_t)ef_->recordSize) return sw(0x6700);
+    if (ef_->type != EfType::Cyclic) return sw(0x6A84);
+    ef_->head = (ef_->head + ef_->recordCount - 1) % ef_->recordCount;
+    std::memcpy(record(1), c.data, c.lc);
+    record_ = 1;
+    return sw(0x9000);
+}
+
+// FCP: 82 — дескриптор (и размер/число записей), 83 — FID, 80/81 — размер, 88 — SFI.
+// Чего нет в команде, берётся из узла разметки с тем же FID в текущем DF.
+std::vector<uint8_t> SimCard::createFile(const Apdu& c){
+    if (c.lc < 2 || c.data[0] != 0x62) return sw(0x6A80);
+    const uint8_t* p = c.data + 2;
+    const uint8_t* end = c.data + std::min<size_t>(c.lc, 2 + c.data[1]);
+    int desc = -1, fid = -1, size = -1, rs = 0, rc = 0, sfi = -1;
+    while (p + 2 <= end && p + 2 + p[1] <= end) {
+        const uint8_t tag = p[0], len = p[1];
+        const uint8_t* v = p + 2;
+        if (tag == 0x82 && len >= 1) {
+            desc = v[0];
+            if (len >= 4) rs = (v[2]<<8) | v[3];
+            if (len >= 5) rc = v[4];
+        } else if (tag == 0x83 && len == 2) {
+            fid = (v[0]<<8) | v[1];
+        } else if (tag == 0x88) {
+            sfi = len ? v[0] >> 3 : 0;
+        } else if ((tag == 0x80 || tag == 0x81) && len >= 1 && len <= 2) {
+            size = len == 2 ? (v[0]<<8) | v[1] : v[0];
+        }
+        p += 2 + len;
+    }
+    if (fid < 0) return sw(0x6A80);
+    if (df_->child((uint16_t)fid)) return sw(0x6A89);
+
+    const Node* node = nullptr;
+    if (df_->layout)
+        for (auto& ch : df_->layout->children) if (ch->fid == fid) { node = ch.get(); break; }
+
+    auto f = std::make_unique<SimFile>();
+    f->fid = (uint16_t)fid;
+    f->sfi = uint8_t(sfi >= 0 ? sfi : node && node->sfi ? node->sfi : fid & 0x1F);
+    f->parent = df_;
+    f->layout = node;
+    // дескриптор файла (ISO 7816-4, табл. 12): b8=0, b7 — shareable; DF 111000,
+    // EF — b6..b4 000/001 и структура b3..b1 != 000; прочие значения не определены
+    if (desc >= 0) {
+        const int d = desc & 0xBF;
+        if (d == 0x38) f->type = EfType::DF;
+        else if ((d & 0x80) || (d & 0x38) > 0x08 || !(d & 0x07)) return sw(0x6A80);
+        else if ((d & 0x07) == 0x01) f->type = EfType::Transparent;
+        else if ((d & 0x07) <= 0x05) f->type = EfType::LinearFixed;
+        else f->type = EfType::Cyclic;
+    } else if (node) f->type = node->type;
+    else return sw(0x6A80);
+    if (node) {
+        if (size < 0) size = node->size;
+        if (!rs) rs = node->recordSize;
+        if (!rc) rc = node->recordCount;
+    }
+    if (f->type==EfType::Transparent) {
+        f->data.assign((size_t)std::max(size, 0), 0x00);
+    } else if (isRecords(f.get())) {
+        if (rs <= 0 || rc <= 0) return sw(0x6A80);
+        f->recordSize = rs;
+        f->recordCount = rc;
+        f->data.assign((size_t)rs * rc, 0x00);
+    }
+    SimFile* made = f.get();
+    df_->children.push_back(std::move(f));
+    enter(made);
+    return sw(0x9000);
+}
+
+} // namespace smartio
@@ -0,0 +1,74 @@
+#ifndef SIMCARD_H
+#define SIMCARD_H
+
+#pragma once
+#include "Rik2Model.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace smartio {
+
+// Файл карты в памяти. EF с записями хранят recordCount*recordSize байт подряд.
+struct SimFile {
+    uint16_t fid = 0;
+    uint8_t sfi = 0;                // EF: из разметки, иначе младшие 5 бит FID
+    EfType type = EfType::DF;
+    std::vector<uint8_t> data;
+    int recordSize = 0, recordCount = 0;
+    int head = 0;                   // циклический EF: физический номер записи 1 (самой свежей)
+    const Node* layout = nullptr;   // узел разметки (размеры для CREATE FILE)
+    SimFile* parent = nullptr;
+    std::vector<std::unique_ptr<SimFile>> children;
+
+    SimFile* child(uint16_t f) const;
+};
+
+// Файловая система ISO/IEC 7816-4 по разметке РИК-2: SELECT, READ/UPDATE BINARY,
+// READ/UPDATE/APPEND RECORD, CREATE FILE и команда серийного номера из разметки.
+class SimCard {
+public:
+    SimCard(std::shared_ptr<const Rik2Layout> layout, uint64_t serial, bool blank, bool extendedLength);
+
+    const std::vector<uint8_t>& atr() const { return atr_; }
+    bool extendedLength() const { return extended_; }
+    void reset();
+    std::vector<uint8_t> process(const uint8_t* apdu, size_t n);
+
+private:
+    struct Apdu {
+        uint8_t cla = 0, ins = 0, p1 = 0, p2 = 0;
+        const uint8_t* data = nullptr;
+        size_t lc = 0, le = 0;
+        bool extended = false;
+    };
+
+    std::shared_ptr<const Rik2Layout> layout_;
+    std::unique_ptr<SimFile> mf_;
+    SimFile* df_ = nullptr;
+    SimFile* ef_ = nullptr;
+    int record_ = 0;                // текущая запись текущего EF, 0 — нет
+    std::vector<uint8_t> atr_, serial_, serialApdu_;
+    bool extended_;
+
+    static bool parse(const uint8_t* a, size_t n, Apdu& c);
+    std::unique_ptr<SimFile> build(const Node& n, SimFile* parent, bool blank);
+    void fillSerial(uint64_t serial);
+    SimFile* byPath(SimFile* from, const uint8_t* p, size_t n) const;
+    SimFile* efBySfi(uint8_t sfi) const;
+    void enter(SimFile* f);
+
+    std::vector<uint8_t> select(const Apdu& c);
+    std::vector<uint8_t> readBinary(const Apdu& c);
+    std::vector<uint8_t> updateBinary(const Apdu& c);
+    std::vector<uint8_t> readRecord(const Apdu& c);
+    std::vector<uint8_t> updateRecord(const Apdu& c);
+    std::vector<uint8_t> appendRecord(const Apdu& c);
+    std::vector<uint8_t> createFile(const Apdu& c);
+    bool recordTarget(const Apdu& c, std::vector<uint8_t>& err);
+    uint8_t* record(int no);
+};
+
+} // namespace smartio
+
+#endif // SIMCARD_H
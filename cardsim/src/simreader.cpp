@@ -0,0 +1,203 @@
+#include "simreader.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <thread>
+
+namespace smartio {
+
+static std::atomic<uint64_t> g_nextSerial{1};
+
+static uint32_t envU32(const char* name, uint32_t def){
+    const char* e = std::getenv(name);
+    return e && *e ? (uint32_t)std::strtoul(e, nullptr, 10) : def;
+}
+
+SimReader::SimReader() : cfg_(cardSimDefaults()) {}
+
+void SimReader::configure(const CardSimConfig& cfg){
+    std::lock_guard<std::mutex> lk(m_);
+    cfg_ = cfg;
+    layoutPath_ = cfg.layoutPath ? cfg.layoutPath : "";
+    cfg_.layoutPath = nullptr;
+    configured_ = true;
+}
+
+// Разметка разбирается один раз на путь: тысячи карт делят одно дерево узлов.
+std::shared_ptr<const Rik2Layout> SimReader::layout(const std::string& path){
+    static std::mutex m;
+    static std::map<std::string, std::shared_ptr<const Rik2Layout>> cache;
+    std::lock_guard<std::mutex> lk(m);
+    auto& l = cache[path];
+    if (!l) {
+        try { l = std::make_shared<Rik2Layout>(Rik2Parser::parseFile(QString::fromStdString(path))); }
+        catch (const std::exception& e) { cache.erase(path); throw ReaderError(std::string("Симулятор: ") + e.what()); }
+    }
+    return l;
+}
+
+void SimReader::open(const OpenParams& p){
+    (void)p;
+    std::lock_guard<std::mutex> lk(m_);
+    if (!configured_) {
+        const CardSimConfig d = cardSimDefaults();
+        if (const char* e = std::getenv("SMARTIO_SIM_LAYOUT")) layoutPath_ = e;
+        cfg_.apduUs = envU32("SMARTIO_SIM_APDU_US", d.apduUs);
+        cfg_.byteUs = envU32("SMARTIO_SIM_BYTE_US", d.byteUs);
+        cfg_.baud = envU32("SMARTIO_SIM_BAUD", d.baud);
+        cfg_.realtime = (int)envU32("SMARTIO_SIM_REALTIME", (uint32_t)d.realtime);
+        cfg_.blank = (int)envU32("SMARTIO_SIM_BLANK", (uint32_t)d.blank);
+        cfg_.extendedLength = (int)envU32("SMARTIO_SIM_EXTENDED", (uint32_t)d.extendedLength);
+    }
+    if (layoutPath_.empty()) throw ReaderError("Симулятор: не задана разметка (cardsim_configure / SMARTIO_SIM_LAYOUT)");
+    const uint64_t serial = cfg_.serial ? cfg_.serial : g_nextSerial.fetch_add(1, std::memory_order_relaxed);
+    card_ = std::make_unique<SimCard>(layout(layoutPath_), serial, cfg_.blank != 0, cfg_.extendedLength != 0);
+    powered_ = false;
+    elapsedUs_.store(0, std::memory_order_relaxed);
+}
+
+void SimReader::close(){
+    std::lock_guard<std::mutex> lk(m_);
+    card_.reset();
+    powered_ = false;
+}
+
+ReaderInfo SimReader::info() const {
+    std::lock_guard<std::mutex> lk(m_);
+    ReaderInfo i;
+    i.name = "Card simulator";
+    i.backend = "sim";
+    i.path = layoutPath_;
+    const bool ext = card_ && card_->extendedLength();
+    i.level = ext ? ExchangeLevel::ExtendedApdu : ExchangeLevel::ShortApdu;
+    i.maxCommandData = ext ? 65535 : 255;
+    i.maxResponseData = ext ? 65536 : 256;
+    if (powered_) {
+        i.activeProtocol = 0;
+        i.activeBaud = cfg_.baud;
+    }
+    return i;
+}
+
+CardPresence SimReader::cardStatus(){
+    std::lock_guard<std::mutex> lk(m_);
+    if (!card_) throw ReaderError("Закрытый");
+    return powered_ ? CardPresence::PresentActive : CardPresence::PresentInactive;
+}
+
+// Модель времени: накладные ридера + цена байта + линия карты (12 etu на байт).
+uint64_t SimReader::cost(size_t bytes) const {
+    uint64_t us = cfg_.apduUs + (uint64_t)bytes * cfg_.byteUs;
+    if (cfg_.baud) us += (uint64_t)bytes * 12 * 1000000 / cfg_.baud;
+    return us;
+}
+
+void SimReader::spend(StatOp op, uint64_t us){
+    elapsedUs_.fetch_add(us, std::memory_order_relaxed);
+    metrics_.recordUs(op, us);
+    if (cfg_.realtime) std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+std::vector<uint8_t> SimReader::powerOn(ResetMode mode){
+    std::vector<uint8_t> atr;
+    CardEventCallback cb;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        if (!card_) throw ReaderError("Закрытый");
+        if (mode == ResetMode::Reuse && powered_) return card_->atr();
+        card_->reset();
+        atr = card_->atr();
+        powered_ = true;
+        cb = cardCb_;
+    }
+    spend(StatOp::IccPowerOn, cost(atr.size()));
+    if (cb) cb(0, CardPresence::PresentActive);
+    return atr;
+}
+
+void SimReader::powerOff(){
+    CardEventCallback cb;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        if (!card_) throw ReaderError("Закрытый");
+        powered_ = false;
+        cb = cardCb_;
+    }
+    if (cb) cb(0, CardPresence::PresentInactive);
+}
+
+// Виртуальную карту не вынимают: событий нет.
+bool SimReader::waitCardEvent(unsigned timeoutMs){
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+    return false;
+}
+
+void SimReader::setCardEventCallback(CardEventCallback cb){
+    std::lock_guard<std::mutex> lk(m_);
+    cardCb_ = std::move(cb);
+}
+
+std::vector<uint8_t> SimReader::exchange(const uint8_t* capdu, size_t len){
+    std::vector<uint8_t> r;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        if (!card_) throw ReaderError("Закрытый");
+        if (!powered_) throw ReaderError("Карта не активирована (powerOn)");
+        r = card_->process(capdu, len);
+    }
+    metrics_.exchanges.fetch_add(1, std::memory_order_relaxed);
+    metrics_.bytesOut.fetch_add(len, std::memory_order_relaxed);
+    metrics_.bytesIn.fetch_add(r.size(), std::memory_order_relaxed);
+    spend(StatOp::Apdu, cost(len + r.size()));
+    return r;
+}
+
+XfrResult SimReader::transmit(const std::vector<uint8_t>& capdu, unsigned timeoutMs){
+    (void)timeoutMs;
+    return XfrResult{exchange(capdu.data(), capdu.size())};
+}
+
+// Ответ готов сразу: done вызывается в потоке вызывающего.
+void SimReader::transmitAsync(const std::vector<uint8_t>& capdu, XfrCallback done, unsigned timeoutMs){
+    XfrResult xr;
+    std::exception_ptr err;
+    try { xr = transmit(capdu, timeoutMs); }
+    catch (...) { err = std::current_exception(); }
+    if (done) done(std::move(xr), err);
+}
+
+BatchResult SimReader::transmitBatch(const ApduBatch& batch, unsigned timeoutMs){
+    (void)timeoutMs;
+    BatchResult res;
+    res.offsets.reserve(batch.size());
+    for (size_t i=0; i<batch.size(); ++i) {
+        const auto r = exchange(batch.apdu(i), batch.length(i));
+        res.offsets.push_back(res.data.size());
+        res.data.insert(res.data.end(), r.begin(), r.end());
+        if (batch.stopOnError[i] && res.sw(i) != 0x9000) break;
+    }
+    return res;
+}
+
+size_t SimReader::transmitInto(const uint8_t* capdu, size_t len, uint8_t* rapdu, size_t cap){
+    const auto r = exchange(capdu, len);
+    if (r.size() <= cap) std::memcpy(rapdu, r.data(), r.size());
+    return r.size();
+}
+
+std::vector<uint8_t> SimReader::vendorControl(const std::vector<uint8_t>& payload){
+    (void)payload;
+    return {};
+}
+
+ReaderStats SimReader::stats(bool reset){
+    return metrics_.snapshot(reset);
+}
+
+size_t SimReader::dumpTrace(const std::string& pcapPath){
+    (void)pcapPath;
+    throw ReaderError("Трассировка USB недоступна: карта виртуальная");
+}
+
+} // namespace smartio
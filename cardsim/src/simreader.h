@@ -0,0 +1,69 @@
+#ifndef SIMREADER_H
+#define SIMREADER_H
+
+#pragma once
+#include "ReaderApi.h"
+#include "CardSim.h"
+#include "metrics.h"
+#include "simcard.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace smartio {
+
+// Ридер с виртуальной картой по разметке РИК-2. Каждый экземпляр — своя карта
+// со своим серийным номером; разобранная разметка общая для всех экземпляров.
+class SimReader final : public ICardReader {
+public:
+    SimReader();
+
+    void configure(const CardSimConfig& cfg);
+    uint64_t elapsedUs() const { return elapsedUs_.load(std::memory_order_relaxed); }
+
+    void open(const OpenParams& params) override;
+    void close() override;
+    ReaderInfo info() const override;
+
+    CardPresence cardStatus() override;
+    std::vector<uint8_t> powerOn(ResetMode mode = ResetMode::Cold) override;
+    void powerOff() override;
+    bool waitCardEvent(unsigned timeoutMs) override;
+    void setCardEventCallback(CardEventCallback cb) override;
+
+    XfrResult transmit(const std::vector<uint8_t>& capdu,
+                       unsigned timeoutMs) override;
+    void transmitAsync(const std::vector<uint8_t>& capdu,
+                       XfrCallback done,
+                       unsigned timeoutMs) override;
+    using ICardReader::transmitAsync;
+    BatchResult transmitBatch(const ApduBatch& batch, unsigned timeoutMs) override;
+    // Длина ответа; больше cap — ответ не скопирован.
+    size_t transmitInto(const uint8_t* capdu, size_t len, uint8_t* rapdu, size_t cap);
+
+    std::vector<uint8_t> vendorControl(const std::vector<uint8_t>& payload) override;
+
+    ReaderStats stats(bool reset) override;
+    size_t dumpTrace(const std::string& pcapPath) override;
+
+private:
+    mutable std::mutex m_;
+    CardSimConfig cfg_;
+    std::string layoutPath_;
+    bool configured_ = false;
+    std::unique_ptr<SimCard> card_;
+    bool powered_ = false;
+    CardEventCallback cardCb_;
+    std::atomic<uint64_t> elapsedUs_{0};
+    ReaderMetrics metrics_;
+
+    static std::shared_ptr<const Rik2Layout> layout(const std::string& path);
+    uint64_t cost(size_t bytes) const;
+    void spend(StatOp op, uint64_t us);
+    std::vector<uint8_t> exchange(const uint8_t* capdu, size_t len);
+};
+
+} // namespace smartio
+
+#endif // SIMREADER_H
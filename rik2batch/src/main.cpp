@@ -0,0 +1,242 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QDir>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ReaderSession.hpp"
+#include "Rik2Model.hpp"
+#include "Rik2Worker.hpp"
+
+using namespace smartio;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// Общая очередь заданий (номера карт по порядку): задание берёт ридер,
+// в котором есть необработанная карта.
+class JobQueue {
+public:
+    explicit JobQueue(unsigned n){ for (unsigned i=1; i<=n; ++i) jobs_.push_back(i); }
+    bool take(unsigned& job){
+        std::lock_guard<std::mutex> lk(m_);
+        if (jobs_.empty()) return false;
+        job = jobs_.front(); jobs_.pop_front();
+        return true;
+    }
+    bool empty() const { std::lock_guard<std::mutex> lk(m_); return jobs_.empty(); }
+private:
+    mutable std::mutex m_;
+    std::deque<unsigned> jobs_;
+};
+
+// Ридер линии: свой поток, своя сессия библиотеки.
+struct Line {
+    std::string path;
+    ReaderSession session;
+    unsigned cards = 0, failed = 0;
+    double busyMs = 0;
+    ReaderStats st;
+};
+
+struct Options {
+    bool markup = false;
+    QDir outDir;
+    bool loop = false;      // повторять на той же карте, не дожидаясь смены
+    bool once = false;      // без --count: по одной карте, уже вставленной в ридер
+    bool verbose = false;
+};
+
+std::mutex outMutex;
+
+void say(const Line& ln, const QString& text){
+    std::lock_guard<std::mutex> lk(outMutex);
+    std::cout << "[" << ln.path << "] " << text.toStdString() << std::endl;
+}
+
+void runLine(Line& ln, JobQueue& q, const Options& o, const Rik2Layout& L){
+    Rik2Worker w(ln.session);
+    auto log = [&](const QString& s){ if (o.verbose) say(ln, s); };
+    bool handled = false;   // карта в ридере уже обработана
+    while (!q.empty()) {
+        CardPresence st;
+        try { st = ln.session.status(); }
+        catch (const std::exception& e) { say(ln, QString("ридер недоступен: %1").arg(e.what())); return; }
+        if (o.once && (handled || st == CardPresence::NotPresent)) return;
+        if (st == CardPresence::NotPresent) handled = false;
+        if (st == CardPresence::NotPresent || (handled && !o.loop)) {
+            // без уведомлений ридера waitCardEvent возвращается сразу: опрос не чаще 4 раз в секунду
+            const auto until = Clock::now() + std::chrono::milliseconds(250);
+            if (!ln.session.waitCardEvent(250)) std::this_thread::sleep_until(until);
+            continue;
+        }
+        unsigned job = 0;
+        if (!q.take(job)) return;
+        const auto t0 = Clock::now();
+        try {
+            if (o.markup) {
+                (void)w.getAtr(ResetMode::Reuse);
+                w.markupCard(L, log);
+            } else {
+                const QString sub = QString("%1").arg(job, 5, 10, QLatin1Char('0'));
+                o.outDir.mkpath(sub);
+                w.readAll(L, QDir(o.outDir.filePath(sub)), log);
+            }
+            ++ln.cards;
+            say(ln, QString("карта %1: готово за %2 мс").arg(job)
+                    .arg(std::chrono::duration<double, std::milli>(Clock::now() - t0).count(), 0, 'f', 0));
+        } catch (const std::exception& e) {
+            ++ln.failed;
+            say(ln, QString("карта %1: ошибка: %2").arg(job).arg(e.what()));
+        }
+        ln.busyMs += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        handled = true;
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    // общий с rik2gui кэш профилей карт (CardProfile)
+    QCoreApplication::setApplicationName("rik2gui");
+    QCoreApplication::setApplicationVersion("0.1");
+
+    QCommandLineParser p;
+    p.setApplicationDescription(
+        "Пакетная обработка карт РИК-2 на всех подключённых ридерах, без GUI.\n"
+        "Команды:\n"
+        "  read <каталог>   — считать все файлы разметки; карта N — в подкаталог NNNNN\n"
+        "  markup           — разметить карты (createApdus; изменяет карты!)\n"
+        "Каждый ридер работает в своём потоке и берёт задания из общей очереди,\n"
+        "как только в нём оказывается новая карта.\n"
+        );
+    p.addHelpOption();
+    p.addVersionOption();
+
+    QCommandLineOption libOpt(QStringList() << "lib",
+                              "Путь/имя библиотеки (.so), по умолчанию 'acr38usb'", "ПУТЬ", "acr38usb");
+    QCommandLineOption vidOpt(QStringList() << "vid", "VID (hex), по умолчанию 072F", "VID", "072F");
+    QCommandLineOption pidOpt(QStringList() << "pid", "PID (hex), по умолчанию 9000", "PID", "9000");
+    QCommandLineOption timeoutOpt(QStringList() << "timeout",
+                                  "Таймаут обмена, мс (по умолчанию 2000)", "MS", "2000");
+    QCommandLineOption layoutOpt(QStringList() << "layout", "JSON-разметка РИК-2", "ФАЙЛ");
+    QCommandLineOption pathOpt(QStringList() << "path",
+                               "Ридер по пути на шине (можно несколько раз), по умолчанию — все", "PATH");
+    QCommandLineOption countOpt(QStringList() << "count",
+                                "Всего карт; по умолчанию — по одной в каждом ридере с картой", "N", "0");
+    QCommandLineOption loopOpt(QStringList() << "loop",
+                               "Не ждать смены карты: задания повторяются на той же (стенд, cardsim)");
+    QCommandLineOption verboseOpt(QStringList() << "verbose", "Журнал Rik2Worker по каждой карте");
+    p.addOption(libOpt); p.addOption(vidOpt); p.addOption(pidOpt); p.addOption(timeoutOpt);
+    p.addOption(layoutOpt); p.addOption(pathOpt); p.addOption(countOpt);
+    p.addOption(loopOpt); p.addOption(verboseOpt);
+
+    p.addPositionalArgument("command", "read <каталог> | markup");
+    p.process(app);
+    const auto pos = p.positionalArguments();
+    if (pos.isEmpty()) p.showHelp(0);
+
+    Options o;
+    const QString cmd = pos.at(0).toLower();
+    if (cmd=="read") {
+        if (pos.size()<2) { std::cerr << "Использование: read <каталог>\n"; return 2; }
+        o.outDir = QDir(pos.at(1));
+        if (!o.outDir.mkpath(".")) { std::cerr << "Не удалось создать каталог " << pos.at(1).toStdString() << "\n"; return 1; }
+    } else if (cmd=="markup") {
+        o.markup = true;
+    } else {
+        std::cerr << "Неизвестная команда: " << cmd.toStdString() << "\n";
+        return 2;
+    }
+    o.loop = p.isSet(loopOpt);
+    o.verbose = p.isSet(verboseOpt);
+
+    bool okv=false, okp=false, okt=false, okc=false;
+    const uint16_t vid = p.value(vidOpt).toUShort(&okv,16);
+    const uint16_t pid = p.value(pidOpt).toUShort(&okp,16);
+    const unsigned timeout = p.value(timeoutOpt).toUInt(&okt,10);
+    unsigned count = p.value(countOpt).toUInt(&okc,10);
+    if (!okv || !okp || !okt || !okc){
+        std::cerr << "Ошибка: некорректные значения VID/PID/timeout/count\n";
+        return 2;
+    }
+    if (!p.isSet(layoutOpt)) { std::cerr << "Не задана разметка (--layout)\n"; return 2; }
+
+    Rik2Layout layout;
+    try {
+        layout = Rik2Parser::parseFile(p.value(layoutOpt));
+    } catch (const std::exception& e) {
+        std::cerr << "Разметка: " << e.what() << "\n";
+        return 1;
+    }
+
+    // --- ридеры ---
+    std::vector<std::string> paths;
+    for (const auto& s : p.values(pathOpt)) paths.push_back(s.toStdString());
+    if (paths.empty()) {
+        ReaderSession probe;
+        QString err;
+        if (!probe.loadLibrary(p.value(libOpt), &err)) { std::cerr << err.toStdString() << "\n"; return 1; }
+        for (const auto& l : probe.readers(vid, pid)) paths.push_back(readerPath(l));
+        if (paths.empty()) paths.push_back(std::string());  // библиотека без enumerate_readers
+    }
+
+    std::vector<std::unique_ptr<Line>> lines;
+    unsigned withCard = 0;
+    for (const auto& path : paths) {
+        auto ln = std::make_unique<Line>();
+        ln->path = path.empty() ? "—" : path;
+        QString err;
+        if (!ln->session.loadLibrary(p.value(libOpt), &err) ||
+            !ln->session.open(vid, pid, true, -1, timeout, &err, path)) {
+            std::cerr << "[" << ln->path << "] " << err.toStdString() << "\n";
+            continue;
+        }
+        try { if (ln->session.status() != CardPresence::NotPresent) ++withCard; } catch (...) {}
+        lines.push_back(std::move(ln));
+    }
+    if (lines.empty()) { std::cerr << "Ни один ридер не открыт\n"; return 1; }
+    o.once = !count;
+    if (!count) count = withCard;
+    if (!count) { std::cerr << "Нет карт в ридерах\n"; return 1; }
+
+    // --- работа ---
+    JobQueue queue(count);
+    const auto t0 = Clock::now();
+    std::vector<std::thread> threads;
+    for (auto& ln : lines)
+        threads.emplace_back([&, l = ln.get()]{ runLine(*l, queue, o, layout); });
+    for (auto& t : threads) t.join();
+    const double wallS = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    // --- итог по ридерам ---
+    std::cout << "\n" << std::left << std::setw(14) << "Ридер" << std::right
+              << std::setw(7) << "карт" << std::setw(8) << "ошибок" << std::setw(9) << "APDU"
+              << std::setw(11) << "принято,КБ" << std::setw(10) << "занят,с"
+              << std::setw(10) << "карт/мин" << std::setw(9) << "КБ/с" << "\n";
+    unsigned cards = 0, failed = 0;
+    for (auto& ln : lines) {
+        try { ln->st = ln->session.stats(); } catch (...) {}
+        const double busyS = ln->busyMs / 1000;
+        const double kb = ln->st.bytesIn / 1024.0;
+        std::cout << std::left << std::setw(14) << ln->path << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(7) << ln->cards << std::setw(8) << ln->failed
+                  << std::setw(9) << ln->st.latency[(size_t)StatOp::Apdu].count
+                  << std::setw(11) << kb << std::setw(10) << busyS
+                  << std::setw(10) << (busyS > 0 ? ln->cards * 60 / busyS : 0)
+                  << std::setw(9) << (busyS > 0 ? kb / busyS : 0) << "\n";
+        cards += ln->cards; failed += ln->failed;
+        ln->session.close();
+    }
+    std::cout << "Всего: карт " << cards << ", ошибок " << failed << ", " << std::setprecision(1)
+              << wallS << " с, " << (wallS > 0 ? cards * 60 / wallS : 0) << " карт/мин\n";
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <QString>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Что известно о типе карты (ключ — ATR): пробуется один раз, дальше берётся из кэша.
+struct CardProfile {
+    enum class Chaining { Unknown, None, GetResponse, LeRetry };
+
+    QString atrHash;                // SHA-256 ATR, hex
+    int maxLe = 0xFF;               // байт данных на один READ BINARY, подтверждено картой
+    int maxLc = 0xFF;               // байт данных на один UPDATE BINARY
+    int extended = -1;              // расширенные Lc/Le: 1/0, -1 — не проверялись
+    int probedLe = 0;               // Le пробы; maxLe == probedLe — предел карты не достигнут
+    Chaining chaining = Chaining::Unknown;  // 61xx — GET RESPONSE, 6Cxx — повтор с Le=xx
+    int multiRecord = -1;           // READ RECORD «от P1 до последней» (P2=05): 1/0, -1 — не проверялось
+};
+
+// Профили на диске: <AppDataLocation>/profiles/<хэш ATR>.json
+class CardProfileCache {
+public:
+    explicit CardProfileCache(const QString& dir = QString());
+
+    static QString atrHash(const std::vector<uint8_t>& atr);
+    std::optional<CardProfile> load(const QString& hash) const;
+    bool save(const CardProfile& p) const;
+
+private:
+    QString dir_;
+};
@@ -11,15 +11,24 @@ public:
     ~ReaderSession();
 
     bool loadLibrary(const QString& path, QString* err=nullptr);
-    bool open(uint16_t vid, uint16_t pid, bool detach, int iface, unsigned timeoutMs, QString* err=nullptr);
+    // path — ридер по пути на шине (readers()), пусто — первый vid:pid
+    bool open(uint16_t vid, uint16_t pid, bool detach, int iface, unsigned timeoutMs, QString* err=nullptr,
+              const std::string& path = std::string());
     void close();
     void unload();
 
-    std::vector<uint8_t> powerOn();
+    std::vector<uint8_t> powerOn(smartio::ResetMode mode = smartio::ResetMode::Cold);
     void powerOff();
     std::vector<uint8_t> transmit(const std::vector<uint8_t>& capdu, unsigned timeoutMs = 2000);
+    // Ответ прямо в rapdu (reader_transmit_into, если библиотека её экспортирует).
+    size_t transmitInto(const uint8_t* capdu, size_t len, uint8_t* rapdu, size_t cap, unsigned timeoutMs = 2000);
+    smartio::BatchResult transmitBatch(const smartio::ApduBatch& batch, unsigned timeoutMs = 2000);
     smartio::CardPresence status() const;
     smartio::ReaderInfo info() const;
+    smartio::ReaderStats stats(bool reset = false) const;
+    bool waitCardEvent(unsigned timeoutMs);
+    // Подключённые ридеры (enumerate_readers); библиотека без неё — пусто.
+    std::vector<smartio::ReaderLocation> readers(uint16_t vid, uint16_t pid);
 
     bool isLoaded() const { return (bool)create_; }
     bool isOpen() const { return rdr_!=nullptr; }
@@ -30,10 +39,15 @@ private:
     using CreateFn  = smartio::ICardReader*(*)();
     using DestroyFn = void(*)(smartio::ICardReader*);
     using VerFn     = const char*(*)();
+    using TransmitIntoFn = int(*)(smartio::ICardReader*, const uint8_t*, size_t, uint8_t*, size_t, size_t*, unsigned);
+    using LastErrorFn    = const char*(*)();
 
     CreateFn  create_ = nullptr;
     DestroyFn destroy_ = nullptr;
     VerFn     ver_     = nullptr;
+    TransmitIntoFn xfrInto_ = nullptr;
+    LastErrorFn    lastErr_ = nullptr;
+    std::vector<uint8_t> rbuf_;     // буфер ответа для transmit() через xfrInto_
 
     smartio::ICardReader* rdr_ = nullptr;
 };
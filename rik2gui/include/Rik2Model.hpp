@@ -26,6 +26,7 @@ struct Node {
     int size = 0;
     int recordSize = 0;
     int recordCount = 0;
+    int sfi = 0;            // короткий идентификатор EF (1..30), 0 — не задан
     QString saveAs;
     std::vector<std::vector<uint8_t>> createApdus;
     std::vector<std::unique_ptr<Node>> children;
@@ -35,6 +36,7 @@ struct Rik2Layout {
     QString schema;
     QString cardName;
     std::optional<QString> atrExpected;
+    bool pathSelect = false;    // карта понимает SELECT по пути от MF (P1=08)
     SerialSpec serial;
     std::unique_ptr<Node> root;
 };
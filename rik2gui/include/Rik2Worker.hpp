@@ -3,12 +3,33 @@
 #include <QDir>
 #include "ReaderSession.hpp"
 #include "Rik2Model.hpp"
+#include "CardProfile.hpp"
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+
+// Ход readAll/markupCard: EF n из m, байт данных файлов, APDU с начала операции.
+struct Rik2Progress {
+    int ef = 0, efTotal = 0;
+    uint64_t bytes = 0, apdus = 0;
+};
+
+// Операция прервана requestCancel().
+struct Rik2Cancelled : std::runtime_error {
+    Rik2Cancelled() : std::runtime_error("Операция отменена") {}
+};
 
 class Rik2Worker {
 public:
     explicit Rik2Worker(ReaderSession& s) : s_(s) {}
 
-    std::vector<uint8_t> getAtr();
+    // Вызывается из потока операции после каждого EF и пакета APDU.
+    void setProgressCallback(std::function<void(const Rik2Progress&)> cb) { progressCb_ = std::move(cb); }
+    // Из любого потока: операция бросает Rik2Cancelled перед следующим APDU (пакетом).
+    void requestCancel(bool on = true) { cancel_ = on; }
+
+    // Reuse — ATR активной сессии без сброса карты, если она не менялась
+    std::vector<uint8_t> getAtr(smartio::ResetMode mode = smartio::ResetMode::Cold);
     QString getSerial(const Rik2Layout& L);
 
     void readAll(const Rik2Layout& L, const QDir& outDir, std::function<void(const QString&)> log);
@@ -16,11 +37,46 @@ public:
 
 private:
     ReaderSession& s_;
+    int readChunk_ = 0xFF;      // байт данных на один READ BINARY
+    int writeChunk_ = 0xFF;     // байт данных на один UPDATE BINARY
+    std::vector<uint8_t> atr_;
+    CardProfileCache profiles_;
+    std::optional<CardProfile> profile_;
+    Rik2Progress progress_;
+    std::function<void(const Rik2Progress&)> progressCb_;
+    std::atomic<bool> cancel_{false};
+
+    void begin(const Rik2Layout& L);
+    void reportProgress() { if (progressCb_) progressCb_(progress_); }
+
+    void configureChunks(const std::vector<uint8_t>& atr);
+    void ensureProfile(const Rik2Layout& L, const std::function<void(const QString&)>& log);
+    std::vector<uint8_t> completeResponse(std::vector<uint8_t> r, const std::vector<uint8_t>& apdu);
+    void traverseRead(Node* n, std::vector<uint16_t>& path, const QDir& outDir, const std::function<void(const QString&)>& log);
+
+    // Выбранные на карте DF (путь от MF) и EF; пустой curDf_ — неизвестно
+    // (после сброса, ошибки или CREATE FILE), тогда выбор идёт от MF.
+    std::vector<uint16_t> curDf_;
+    int curEf_ = -1;
+    bool pathSelect_ = false;   // Rik2Layout::pathSelect
 
-    void selectByPath(const std::vector<uint16_t>& path);
-    void selectFid(uint16_t fid);
-    std::vector<uint8_t> readTransparent(int size);
-    std::vector<uint8_t> readLinearFixed(int recSize, int recCount);
+    void selectDf(const std::vector<uint16_t>& df);
+    void selectEf(const std::vector<uint16_t>& df, uint16_t fid);
+    void selectPath(const std::vector<uint16_t>& path);    // путь от MF, последний — EF
+    bool selectFid(uint16_t fid);
+    bool selectFromMf(const std::vector<uint16_t>& path);
+    bool selectParent();
+    void forgetSelection() { curDf_.clear(); curEf_ = -1; }
+    std::vector<uint8_t> transmit(const std::vector<uint8_t>& c, unsigned timeoutMs);
+    // Ответ в rbuf_ без аллокации на APDU; возвращает длину ответа.
+    size_t transmitInto(const uint8_t* c, size_t n, unsigned timeoutMs);
+    uint16_t rbufSw(size_t n) const { return n<2 ? 0 : (uint16_t(rbuf_[n-2])<<8) | rbuf_[n-1]; }
+    std::vector<uint8_t> rbuf_;
+    smartio::BatchResult transmitBatch(const smartio::ApduBatch& batch, unsigned timeoutMs);
+    // sfi — короткий идентификатор EF текущего DF: первая команда сама выбирает файл
+    std::vector<uint8_t> readTransparent(int size, int sfi = 0);
+    std::vector<uint8_t> readRecords(int recSize, int recCount, int sfi = 0);
+    bool readRecordRange(int& from, int recSize, int recCount, int& sfi, std::vector<uint8_t>& out);
 
     void updateTransparent(const std::vector<uint8_t>& data);
 };
@@ -0,0 +1,61 @@
+#include "CardProfile.hpp"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+static const char* chainingName(CardProfile::Chaining c){
+    switch (c){
+    case CardProfile::Chaining::None:        return "none";
+    case CardProfile::Chaining::GetResponse: return "get-response";
+    case CardProfile::Chaining::LeRetry:     return "le-retry";
+    default:                                 return "unknown";
+    }
+}
+
+CardProfileCache::CardProfileCache(const QString& dir)
+    : dir_(!dir.isEmpty() ? dir
+           : QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/profiles") {}
+
+QString CardProfileCache::atrHash(const std::vector<uint8_t>& atr){
+    return QString::fromLatin1(QCryptographicHash::hash(
+        QByteArray((const char*)atr.data(), (int)atr.size()), QCryptographicHash::Sha256).toHex());
+}
+
+std::optional<CardProfile> CardProfileCache::load(const QString& hash) const {
+    QFile f(QDir(dir_).filePath(hash + ".json"));
+    if (!f.open(QIODevice::ReadOnly)) return std::nullopt;
+    const auto o = QJsonDocument::fromJson(f.readAll()).object();
+    if (o.value("atrHash").toString() != hash) return std::nullopt;
+    CardProfile p;
+    p.atrHash = hash;
+    p.maxLe = o.value("maxLe").toInt(0xFF);
+    p.maxLc = o.value("maxLc").toInt(0xFF);
+    p.extended = o.value("extended").toInt(-1);
+    p.probedLe = o.value("probedLe").toInt(0);
+    p.multiRecord = o.value("multiRecord").toInt(-1);
+    const QString c = o.value("chaining").toString();
+    for (auto v : {CardProfile::Chaining::None, CardProfile::Chaining::GetResponse, CardProfile::Chaining::LeRetry})
+        if (c == chainingName(v)) p.chaining = v;
+    if (p.maxLe < 1 || p.maxLc < 1) return std::nullopt;
+    return p;
+}
+
+bool CardProfileCache::save(const CardProfile& p) const {
+    if (!QDir().mkpath(dir_)) return false;
+    QJsonObject o;
+    o["atrHash"] = p.atrHash;
+    o["maxLe"] = p.maxLe;
+    o["maxLc"] = p.maxLc;
+    o["extended"] = p.extended;
+    o["probedLe"] = p.probedLe;
+    o["multiRecord"] = p.multiRecord;
+    o["chaining"] = chainingName(p.chaining);
+    QSaveFile f(QDir(dir_).filePath(p.atrHash + ".json"));
+    if (!f.open(QIODevice::WriteOnly)) return false;
+    f.write(QJsonDocument(o).toJson());
+    return f.commit();
+}
@@ -1,5 +1,6 @@
 // src/ReaderSession.cpp
 #include "ReaderSession.hpp"
+#include <algorithm>
 #include <stdexcept>
 
 ReaderSession::ReaderSession() {}
@@ -19,10 +20,16 @@ bool ReaderSession::loadLibrary(const QString& path, QString* err){
         lib_.unload(); create_ = nullptr; destroy_ = nullptr; ver_ = nullptr;
         return false;
     }
+    // необязательный быстрый путь без std::vector на границе библиотеки
+    xfrInto_ = reinterpret_cast<TransmitIntoFn>(lib_.resolve("reader_transmit_into"));
+    lastErr_ = reinterpret_cast<LastErrorFn>(lib_.resolve("reader_last_error"));
+    if (!lastErr_) xfrInto_ = nullptr;
+    if (xfrInto_) rbuf_.resize(65536 + 2);
     return true;
 }
 
-bool ReaderSession::open(uint16_t vid, uint16_t pid, bool detach, int iface, unsigned timeoutMs, QString* err){
+bool ReaderSession::open(uint16_t vid, uint16_t pid, bool detach, int iface, unsigned timeoutMs, QString* err,
+                         const std::string& path){
     if (!create_) { if (err) *err = "Библиотека не загружена"; return false; }
     close(); // закрыть предыдущий, если был
     rdr_ = create_();
@@ -33,6 +40,8 @@ bool ReaderSession::open(uint16_t vid, uint16_t pid, bool detach, int iface, uns
         p.detachKernelDriver = detach;
         p.interfaceHint = iface;
         p.ioTimeoutMs = timeoutMs;
+        p.autoGetResponse = true;   // ответы 61xx/6Cxx собирает библиотека
+        p.path = path;
         rdr_->open(p);
         return true;
     } catch (const std::exception& ex) {
@@ -58,12 +67,14 @@ void ReaderSession::unload(){
         create_ = nullptr;
         destroy_ = nullptr;
         ver_ = nullptr;
+        xfrInto_ = nullptr;
+        lastErr_ = nullptr;
     }
 }
 
-std::vector<uint8_t> ReaderSession::powerOn(){
+std::vector<uint8_t> ReaderSession::powerOn(smartio::ResetMode mode){
     if (!rdr_) throw std::runtime_error("Ридер не открыт");
-    return rdr_->powerOn();
+    return rdr_->powerOn(mode);
 }
 void ReaderSession::powerOff(){
     if (!rdr_) throw std::runtime_error("Ридер не открыт");
@@ -71,7 +82,26 @@ void ReaderSession::powerOff(){
 }
 std::vector<uint8_t> ReaderSession::transmit(const std::vector<uint8_t>& c, unsigned t){
     if (!rdr_) throw std::runtime_error("Ридер не открыт");
-    return rdr_->transmit(c, t).data;
+    if (!xfrInto_) return rdr_->transmit(c, t).data;
+    const size_t n = transmitInto(c.data(), c.size(), rbuf_.data(), rbuf_.size(), t);
+    return std::vector<uint8_t>(rbuf_.begin(), rbuf_.begin() + n);
+}
+size_t ReaderSession::transmitInto(const uint8_t* c, size_t len, uint8_t* rapdu, size_t cap, unsigned t){
+    if (!rdr_) throw std::runtime_error("Ридер не открыт");
+    if (!xfrInto_) {
+        auto r = rdr_->transmit(std::vector<uint8_t>(c, c + len), t).data;
+        if (r.size() > cap) throw std::runtime_error("Ответ длиннее буфера");
+        std::copy(r.begin(), r.end(), rapdu);
+        return r.size();
+    }
+    size_t n = 0;
+    if (xfrInto_(rdr_, c, len, rapdu, cap, &n, t) != smartio::READER_OK)
+        throw smartio::ReaderError(lastErr_());
+    return n;
+}
+smartio::BatchResult ReaderSession::transmitBatch(const smartio::ApduBatch& b, unsigned t){
+    if (!rdr_) throw std::runtime_error("Ридер не открыт");
+    return rdr_->transmitBatch(b, t);
 }
 smartio::CardPresence ReaderSession::status() const {
     if (!rdr_) throw std::runtime_error("Ридер не открыт");
@@ -81,3 +111,19 @@ smartio::ReaderInfo ReaderSession::info() const {
     if (!rdr_) throw std::runtime_error("Ридер не открыт");
     return rdr_->info();
 }
+smartio::ReaderStats ReaderSession::stats(bool reset) const {
+    if (!rdr_) throw std::runtime_error("Ридер не открыт");
+    return rdr_->stats(reset);
+}
+bool ReaderSession::waitCardEvent(unsigned timeoutMs){
+    if (!rdr_) throw std::runtime_error("Ридер не открыт");
+    return rdr_->waitCardEvent(timeoutMs);
+}
+std::vector<smartio::ReaderLocation> ReaderSession::readers(uint16_t vid, uint16_t pid){
+    using EnumFn = size_t(*)(uint16_t, uint16_t, smartio::ReaderLocation*, size_t);
+    auto enumerate = reinterpret_cast<EnumFn>(lib_.resolve("enumerate_readers"));
+    if (!enumerate) return {};
+    std::vector<smartio::ReaderLocation> locs(enumerate(vid, pid, nullptr, 0));
+    locs.resize(enumerate(vid, pid, locs.data(), locs.size()));
+    return locs;
+}
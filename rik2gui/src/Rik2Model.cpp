@@ -24,10 +24,18 @@ static std::unique_ptr<Node> parseNode(const QJsonObject& o){
     if (n->type==EfType::Transparent) {
         n->size = o.value("size").toInt(0);
         if (n->size<=0) throw std::runtime_error("Для прозрачного EF требуется положительный 'size'");
-    } else if (n->type==EfType::LinearFixed) {
+    } else if (n->type==EfType::LinearFixed || n->type==EfType::Cyclic) {
         n->recordSize = o.value("recordSize").toInt(0);
         n->recordCount= o.value("recordCount").toInt(0);
-        if (n->recordSize<=0 || n->recordCount<=0) throw std::runtime_error("Для линейного EF требуются 'recordSize' и 'recordCount' > 0");
+        if (n->recordSize<=0 || n->recordCount<=0) throw std::runtime_error("Для EF с записями требуются 'recordSize' и 'recordCount' > 0");
+    }
+
+    if (o.contains("sfi")) {
+        if (n->type==EfType::DF) throw std::runtime_error("'sfi' задаётся только для EF");
+        const auto v = o.value("sfi");
+        bool ok = true;
+        n->sfi = v.isString() ? v.toString().toInt(&ok, 16) : v.toInt(0);
+        if (!ok || n->sfi<1 || n->sfi>30) throw std::runtime_error("'sfi' должен быть от 1 до 30 (1E)");
     }
 
     n->saveAs = o.value("saveAs").toString();
@@ -60,6 +68,7 @@ Rik2Layout Rik2Parser::parseFile(const QString& path){
     L.cardName = card.value("name").toString("РИК-2");
     QString atr = card.value("atrExpected").toString();
     if (!atr.isEmpty()) L.atrExpected = atr;
+    L.pathSelect = card.value("pathSelect").toBool(false);
 
     // serial
     auto s = card.value("serial").toObject();
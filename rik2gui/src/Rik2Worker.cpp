@@ -1,68 +1,374 @@
 #include "Rik2Worker.hpp"
 #include "Hex.hpp"
+#include "Atr.h"
 #include <QFile>
 #include <QFileInfo>
+#include <algorithm>
+#include <stdexcept>
 
-std::vector<uint8_t> Rik2Worker::getAtr(){ return s_.powerOn(); }
+// Данные R-APDU без SW1 SW2; допускаются 9000 и 6282 (конец файла раньше Le).
+static std::vector<uint8_t> responseData(std::vector<uint8_t> r, const char* what){
+    if (r.size()<2) throw std::runtime_error(std::string(what) + ": пустой ответ карты");
+    const uint16_t sw = (uint16_t(r[r.size()-2])<<8) | r[r.size()-1];
+    if (sw!=0x9000 && sw!=0x6282)
+        throw std::runtime_error(std::string(what) + ": SW=" + bytesToHex({r[r.size()-2], r[r.size()-1]}));
+    r.resize(r.size()-2);
+    return r;
+}
+
+// Заголовок READ BINARY (длина — Le) / UPDATE BINARY (длина — Lc):
+// короткая форма до 0xFF (Le — до 256, 00), иначе расширенная 00 L1 L2.
+static std::vector<uint8_t> binaryApdu(uint8_t ins, int off, int len){
+    if (len<=0xFF || (ins==0xB0 && len==0x100)) return {0x00,ins,(uint8_t)(off>>8),(uint8_t)(off&0xFF),(uint8_t)len};
+    return {0x00,ins,(uint8_t)(off>>8),(uint8_t)(off&0xFF),0x00,(uint8_t)(len>>8),(uint8_t)(len&0xFF)};
+}
+
+// Запрошенный Le команды READ BINARY из binaryApdu.
+static int askedLe(const uint8_t* a, size_t n){
+    if (n==5) return a[4] ? a[4] : 0x100;
+    const int le = (a[5]<<8) | a[6];
+    return le ? le : 0x10000;
+}
+
+static uint16_t swOf(const std::vector<uint8_t>& r){
+    return r.size()<2 ? 0 : (uint16_t(r[r.size()-2])<<8) | r[r.size()-1];
+}
+
+static int countEfs(const Node* n){
+    int c = n->type==EfType::DF ? 0 : 1;
+    for (auto& ch : n->children) c += countEfs(ch.get());
+    return c;
+}
+
+// Самый большой прозрачный EF разметки — на нём пробуется профиль карты.
+static void largestEf(const Node* n, std::vector<uint16_t>& path, std::vector<uint16_t>& best, int& size){
+    path.push_back(n->fid);
+    if (n->type==EfType::Transparent && n->size>size) { best = path; size = n->size; }
+    for (auto& ch : n->children) largestEf(ch.get(), path, best, size);
+    path.pop_back();
+}
+
+std::vector<uint8_t> Rik2Worker::getAtr(smartio::ResetMode mode){
+    forgetSelection();
+    auto atr = s_.powerOn(mode);
+    configureChunks(atr);
+    return atr;
+}
+
+void Rik2Worker::configureChunks(const std::vector<uint8_t>& atr){
+    readChunk_ = writeChunk_ = 0xFF;
+    atr_ = atr;
+    profile_ = profiles_.load(CardProfileCache::atrHash(atr));
+    const auto inf = s_.info();
+    if (profile_){
+        readChunk_  = (int)std::min<size_t>(profile_->maxLe, std::max<size_t>(inf.maxResponseData, 0xFF));
+        writeChunk_ = (int)std::min<size_t>(profile_->maxLc, std::max<size_t>(inf.maxCommandData, 0xFF));
+        return;
+    }
+    if (!smartio::parseAtr(atr).extendedLength) return;
+    // смещение в P1-P2 ограничено 15 битами, больше 0x7FFF за раз не бывает нужно
+    if (inf.maxResponseData > 0x100) readChunk_  = (int)std::min<size_t>(inf.maxResponseData, 0x7FFF);
+    if (inf.maxCommandData  > 0xFF)  writeChunk_ = (int)std::min<size_t>(inf.maxCommandData, 0x7FFF);
+}
 
 QString Rik2Worker::getSerial(const Rik2Layout& L){
+    pathSelect_ = L.pathSelect;
     // 1) APDU-способ
     if (!L.serial.apdu.isEmpty()){
         auto c = hexToBytes(L.serial.apdu.toStdString());
-        auto r = s_.transmit(c, 2000);
+        auto r = transmit(c, 2000);
         return QString::fromStdString(bytesToHex(r));
     }
     // 2) EF-способ
     if (!L.serial.efPath.empty()){
-        selectByPath(L.serial.efPath);
+        selectPath(L.serial.efPath);
         std::vector<uint8_t> data;
         if (L.serial.efType==EfType::Transparent){
             data = readTransparent(L.serial.size);
         } else {
-            data = readLinearFixed(L.serial.size, 1);
+            data = readRecords(L.serial.size, 1);
         }
         return QString::fromStdString(bytesToHex(data));
     }
     return "Н/Д";
 }
 
-void Rik2Worker::selectFid(uint16_t fid){
-    std::vector<uint8_t> apdu = {0x00,0xA4,0x00,0x0C,0x02, (uint8_t)(fid>>8),(uint8_t)(fid&0xFF)};
-    (void)s_.transmit(apdu, 2000);
+// Разовая проба типа карты на самом большом прозрачном EF разметки: READ BINARY
+// с Le=00 (256 байт) и, если карта заявляет расширенные длины, с расширенным Le.
+// Запись не пробуется (она меняет карту): Lc берётся равным подтверждённому Le.
+void Rik2Worker::ensureProfile(const Rik2Layout& L, const std::function<void(const QString&)>& log){
+    std::vector<uint16_t> path, best;
+    int size = 0;
+    largestEf(L.root.get(), path, best, size);
+    if (best.empty()) return;
+
+    const auto inf = s_.info();
+    const bool ext = smartio::parseAtr(atr_).extendedLength;
+    const int extLe = (int)std::min<size_t>({(size_t)size, inf.maxResponseData, 0x7FFF});
+    const bool tryExt = ext && extLe > 0x100 &&
+        (!profile_ || profile_->extended < 0 ||
+         (profile_->extended == 1 && profile_->maxLe == profile_->probedLe && extLe > profile_->probedLe));
+    if (profile_ && profile_->chaining != CardProfile::Chaining::Unknown && !tryExt) return;
+
+    CardProfile p = profile_ ? *profile_ : CardProfile{};
+    p.atrHash = CardProfileCache::atrHash(atr_);
+    selectPath(best);
+    if (p.chaining == CardProfile::Chaining::Unknown){
+        p.chaining = CardProfile::Chaining::None;
+        try {
+            const auto r = transmit({0x00,0xB0,0x00,0x00,0x00}, 2000);
+            const uint16_t sw = swOf(r);
+            if (sw==0x9000 || sw==0x6282) p.maxLe = 0x100;
+            else if ((sw>>8)==0x61) p.chaining = CardProfile::Chaining::GetResponse;
+            else if ((sw>>8)==0x6C) p.chaining = CardProfile::Chaining::LeRetry;
+        } catch (const std::exception&) {}
+    }
+    if (tryExt){
+        p.probedLe = extLe;
+        p.extended = 0;
+        try {
+            const auto r = transmit(binaryApdu(0xB0, 0, extLe), 5000);
+            const uint16_t sw = swOf(r);
+            if ((sw==0x9000 || sw==0x6282) && r.size()-2 > 0x100){
+                p.extended = 1;
+                p.maxLe = p.maxLc = (int)r.size()-2;
+            }
+        } catch (const std::exception&) {}
+    } else if (!ext) {
+        p.extended = 0;
+    }
+
+    profile_ = p;
+    readChunk_  = (int)std::min<size_t>(p.maxLe, std::max<size_t>(inf.maxResponseData, 0xFF));
+    writeChunk_ = (int)std::min<size_t>(p.maxLc, std::max<size_t>(inf.maxCommandData, 0xFF));
+    if (!profiles_.save(p)) log("Не удалось сохранить профиль карты");
+    log(QString("Профиль карты: READ BINARY по %1 байт, UPDATE BINARY по %2 байт")
+            .arg(readChunk_).arg(writeChunk_));
+}
+
+// Ответ, не уместившийся в Le: 61xx — дочитать GET RESPONSE, 6Cxx — повторить с Le=xx.
+std::vector<uint8_t> Rik2Worker::completeResponse(std::vector<uint8_t> r, const std::vector<uint8_t>& apdu){
+    if ((swOf(r)>>8)==0x6C && apdu.size()==5){
+        auto again = apdu;
+        again[4] = r[r.size()-1];
+        r = transmit(again, 2000);
+    }
+    std::vector<uint8_t> out;
+    while ((swOf(r)>>8)==0x61){
+        out.insert(out.end(), r.begin(), r.end()-2);
+        r = transmit({0x00,0xC0,0x00,0x00,r[r.size()-1]}, 2000);
+    }
+    out.insert(out.end(), r.begin(), r.end());
+    return out;
+}
+
+void Rik2Worker::begin(const Rik2Layout& L){
+    progress_ = {};
+    progress_.efTotal = countEfs(L.root.get());
+    reportProgress();
+}
+
+std::vector<uint8_t> Rik2Worker::transmit(const std::vector<uint8_t>& c, unsigned timeoutMs){
+    const size_t n = transmitInto(c.data(), c.size(), timeoutMs);
+    return std::vector<uint8_t>(rbuf_.begin(), rbuf_.begin() + n);
 }
-void Rik2Worker::selectByPath(const std::vector<uint16_t>& path){
-    for (auto fid: path) selectFid(fid);
+// Любой ответ с SW ошибки (64xx–6Fxx) или исключение — выбор на карте неизвестен.
+size_t Rik2Worker::transmitInto(const uint8_t* c, size_t len, unsigned timeoutMs){
+    if (cancel_) throw Rik2Cancelled();
+    ++progress_.apdus;
+    if (rbuf_.empty()) rbuf_.resize(65536 + 2);
+    try {
+        const size_t n = s_.transmitInto(c, len, rbuf_.data(), rbuf_.size(), timeoutMs);
+        const uint8_t sw1 = n>=2 ? rbuf_[n-2] : 0;
+        if (sw1>=0x64 && sw1<=0x6F && sw1!=0x6C) forgetSelection();
+        return n;
+    } catch (...) {
+        forgetSelection();
+        throw;
+    }
+}
+smartio::BatchResult Rik2Worker::transmitBatch(const smartio::ApduBatch& batch, unsigned timeoutMs){
+    if (cancel_) throw Rik2Cancelled();
+    progress_.apdus += batch.size();
+    try {
+        auto res = s_.transmitBatch(batch, timeoutMs);
+        for (size_t i=0; i<res.count(); ++i){
+            const uint8_t sw1 = uint8_t(res.sw(i)>>8);
+            if (sw1>=0x64 && sw1<=0x6F && sw1!=0x6C) { forgetSelection(); break; }
+        }
+        return res;
+    } catch (...) {
+        forgetSelection();
+        throw;
+    }
+}
+
+bool Rik2Worker::selectFid(uint16_t fid){
+    const uint8_t c[] = {0x00,0xA4,0x00,0x0C,0x02, (uint8_t)(fid>>8),(uint8_t)(fid&0xFF)};
+    return rbufSw(transmitInto(c, sizeof(c), 2000))==0x9000;
+}
+// SELECT по пути от MF (P1=08): путь без самого MF.
+bool Rik2Worker::selectFromMf(const std::vector<uint16_t>& path){
+    if (path.size()<2) return selectFid(path.at(0));
+    std::vector<uint8_t> c = {0x00,0xA4,0x08,0x0C,(uint8_t)((path.size()-1)*2)};
+    for (size_t i=1; i<path.size(); ++i) { c.push_back((uint8_t)(path[i]>>8)); c.push_back((uint8_t)(path[i]&0xFF)); }
+    return rbufSw(transmitInto(c.data(), c.size(), 2000))==0x9000;
+}
+bool Rik2Worker::selectParent(){
+    const uint8_t c[] = {0x00,0xA4,0x03,0x0C};
+    return rbufSw(transmitInto(c, sizeof(c), 2000))==0x9000;
 }
 
-std::vector<uint8_t> Rik2Worker::readTransparent(int size){
+// Минимум SELECT от текущего DF: вверх к общему предку (P1=03) и вниз по FID;
+// если от MF короче или текущий DF неизвестен — с MF, одной командой при pathSelect_.
+void Rik2Worker::selectDf(const std::vector<uint16_t>& df){
+    if (df.empty()) return;
+    if (curDf_==df) { curEf_ = -1; return; }
+    size_t common = 0;
+    while (common<curDf_.size() && common<df.size() && curDf_[common]==df[common]) ++common;
+    const size_t relative = common ? (curDf_.size()-common) + (df.size()-common) : df.size();
+    if (pathSelect_ && df.size()>1 && relative>1){
+        if (!selectFromMf(df)) { forgetSelection(); return; }
+        curDf_ = df;
+        curEf_ = -1;
+        return;
+    }
+    size_t from = 0;
+    if (common>0 && relative < df.size()){
+        for (size_t up = curDf_.size()-common; up>0; --up)
+            if (!selectParent()) { forgetSelection(); break; }
+        if (!curDf_.empty()) from = common;
+    }
+    if (from==0 && !selectFid(df[0])) { forgetSelection(); return; }
+    for (size_t i = from ? from : 1; i<df.size(); ++i)
+        if (!selectFid(df[i])) { forgetSelection(); return; }
+    curDf_ = df;
+    curEf_ = -1;
+}
+void Rik2Worker::selectEf(const std::vector<uint16_t>& df, uint16_t fid){
+    if (!curDf_.empty() && curDf_==df && curEf_==fid) return;
+    if (pathSelect_ && curDf_!=df){
+        std::vector<uint16_t> path = df;
+        path.push_back(fid);
+        if (selectFromMf(path)) { curDf_ = df; curEf_ = fid; }
+        else forgetSelection();
+        return;
+    }
+    selectDf(df);
+    if (curDf_!=df) { (void)selectFid(fid); return; }
+    if (selectFid(fid)) curEf_ = fid;
+}
+void Rik2Worker::selectPath(const std::vector<uint16_t>& path){
+    if (path.empty()) return;
+    selectEf(std::vector<uint16_t>(path.begin(), path.end()-1), path.back());
+}
+
+// Весь файл — один пакет READ BINARY; если карта вернула меньше запрошенного,
+// смещения дальше неверны и остаток дочитывается следующим пакетом.
+// 6282 — конец файла раньше размера из разметки: чтение заканчивается; 6B00 на
+// дочитывании после короткого 9000 — тоже конец файла, а не ошибка.
+std::vector<uint8_t> Rik2Worker::readTransparent(int size, int sfi){
     std::vector<uint8_t> out; out.reserve(size);
+    smartio::ApduBatch batch;
     int remaining = size, off=0;
+    bool continued = false;     // пакет дочитывает после короткого ответа
     while (remaining>0){
-        int chunk = std::min(remaining, 0xFF);
-        std::vector<uint8_t> apdu = {0x00,0xB0,(uint8_t)(off>>8),(uint8_t)(off&0xFF),(uint8_t)chunk};
-        auto r = s_.transmit(apdu, 2000);
-        out.insert(out.end(), r.begin(), r.end());
-        off += chunk; remaining -= chunk;
+        batch.clear();
+        for (int o=off, left=remaining; left>0; ){
+            const int chunk = std::min(left, readChunk_);
+            auto apdu = binaryApdu(0xB0, o, chunk);
+            if (sfi && o==0) apdu[2] = (uint8_t)(0x80 | sfi);
+            batch.add(apdu, true);
+            o += chunk; left -= chunk;
+        }
+        const auto res = transmitBatch(batch, 2000);
+        bool shortRead = false;
+        for (size_t i=0; i<res.count() && !shortRead; ++i){
+            std::vector<uint8_t> raw(res.response(i), res.response(i)+res.length(i));
+            const uint8_t sw1 = raw.size()>=2 ? raw[raw.size()-2] : 0;
+            if (sw1==0x61 || sw1==0x6C)
+                raw = completeResponse(std::move(raw), {batch.apdu(i), batch.apdu(i)+batch.length(i)});
+            const uint16_t sw = swOf(raw);
+            if (sw==0x6B00 && continued && i==0) { remaining = 0; break; }
+            auto r = responseData(std::move(raw), "READ BINARY");
+            const int asked = askedLe(batch.apdu(i), batch.length(i));
+            if (r.empty()) { remaining = 0; break; }
+            if ((int)r.size()>remaining) r.resize(remaining);
+            shortRead = (int)r.size() < asked;
+            out.insert(out.end(), r.begin(), r.end());
+            off += (int)r.size(); remaining -= (int)r.size();
+            progress_.bytes += r.size();
+            if (sw==0x6282) { remaining = 0; break; }
+        }
+        continued = shortRead;
+        reportProgress();
     }
     return out;
 }
-std::vector<uint8_t> Rik2Worker::readLinearFixed(int recSize, int recCount){
+// Записи линейного или циклического EF по номерам 1…recCount. Сначала — READ RECORD
+// «от P1 до последней» (P2=05) с Le на столько целых записей, сколько влезает в ответ;
+// не поддерживает карта (профиль) — по записи, пакетом.
+std::vector<uint8_t> Rik2Worker::readRecords(int recSize, int recCount, int sfi){
     std::vector<uint8_t> out; out.reserve(recSize*recCount);
-    for (int rec=1; rec<=recCount; ++rec){
-        std::vector<uint8_t> apdu = {0x00,0xB2,(uint8_t)rec,0x04,(uint8_t)recSize};
-        auto r = s_.transmit(apdu, 2000);
-        if ((int)r.size()<recSize) r.resize(recSize,0x00);
-        out.insert(out.end(), r.begin(), r.begin()+recSize);
+    int from = 1;
+    // P2=05 выгоден, только если в один ответ помещаются хотя бы две записи; иначе — пакет по записи
+    const bool multi = recCount>1 && 2*recSize<=readChunk_ && (!profile_ || profile_->multiRecord!=0);
+    if (multi){
+        const bool first = !profile_ || profile_->multiRecord<0;
+        const bool ok = readRecordRange(from, recSize, recCount, sfi, out);
+        if (first){
+            if (!profile_) { profile_ = CardProfile{}; profile_->atrHash = CardProfileCache::atrHash(atr_); }
+            profile_->multiRecord = ok ? 1 : 0;
+            (void)profiles_.save(*profile_);
+        }
+    }
+    if (from>recCount) return out;
+
+    smartio::ApduBatch batch;
+    for (int rec=from; rec<=recCount; ++rec){
+        batch.add({0x00,0xB2,(uint8_t)rec,(uint8_t)(sfi ? (sfi<<3)|0x04 : 0x04),(uint8_t)recSize}, true);
+        sfi = 0;
+    }
+    const auto res = transmitBatch(batch, 2000);
+    for (size_t i=0; i<res.count(); ++i){
+        if (res.sw(i)==0x6A83) break;      // записей меньше, чем в разметке
+        auto r = responseData({res.response(i), res.response(i)+res.length(i)}, "READ RECORD");
+        r.resize(recSize, 0x00);
+        out.insert(out.end(), r.begin(), r.end());
+        progress_.bytes += recSize;
     }
     return out;
 }
+
+// Записи from… пачками P2=05; false — карта не отдала ни одной целой пачки.
+// При отказе from указывает на первую непрочитанную запись.
+bool Rik2Worker::readRecordRange(int& from, int recSize, int recCount, int& sfi, std::vector<uint8_t>& out){
+    bool any = false;
+    while (from<=recCount){
+        const int le = std::min(recCount-from+1, readChunk_/recSize) * recSize;
+        std::vector<uint8_t> c = {0x00,0xB2,(uint8_t)from,(uint8_t)(sfi ? (sfi<<3)|0x05 : 0x05)};
+        if (le<=0x100) c.push_back((uint8_t)le);
+        else { c.push_back(0x00); c.push_back((uint8_t)(le>>8)); c.push_back((uint8_t)(le&0xFF)); }
+        const size_t rn = transmitInto(c.data(), c.size(), 5000);
+        const uint16_t sw = rbufSw(rn);
+        const size_t n = rn-2;
+        if ((sw!=0x9000 && sw!=0x6282) || !n || n%recSize || (int)n>le) return any;
+        any = true;
+        sfi = 0;
+        out.insert(out.end(), rbuf_.begin(), rbuf_.begin() + n);
+        from += (int)(n/recSize);
+        progress_.bytes += n;
+    }
+    return true;
+}
 void Rik2Worker::updateTransparent(const std::vector<uint8_t>& data){
     int remaining = (int)data.size(), off=0;
     while (remaining>0){
-        int chunk = std::min(remaining, 0xFF);
-        std::vector<uint8_t> apdu = {0x00,0xD6,(uint8_t)(off>>8),(uint8_t)(off&0xFF),(uint8_t)chunk};
+        int chunk = std::min(remaining, writeChunk_);
+        auto apdu = binaryApdu(0xD6, off, chunk);
         apdu.insert(apdu.end(), data.begin()+off, data.begin()+off+chunk);
-        (void)s_.transmit(apdu, 5000);
+        const size_t rn = transmitInto(apdu.data(), apdu.size(), 5000);
+        if (rbufSw(rn)!=0x9000) (void)responseData(std::vector<uint8_t>(rbuf_.begin(), rbuf_.begin() + rn), "UPDATE BINARY");
         off += chunk; remaining -= chunk;
     }
 }
@@ -73,39 +379,32 @@ static void ensureDir(const QDir& base, const QString& relative){
     for (int i=0;i<parts.size()-1;++i){ d.mkpath(parts[i]); d.cd(parts[i]); }
 }
 
-static void traverseRead(Node* n, std::vector<uint16_t>& path, ReaderSession& s, const QDir& outDir, std::function<void(const QString&)> log){
+void Rik2Worker::traverseRead(Node* n, std::vector<uint16_t>& path, const QDir& outDir, const std::function<void(const QString&)>& log){
     if (n->type==EfType::DF){
         path.push_back(n->fid);
-        for (auto& ch : n->children) traverseRead(ch.get(), path, s, outDir, log);
+        for (auto& ch : n->children) traverseRead(ch.get(), path, outDir, log);
         path.pop_back();
         return;
     }
 
-    std::vector<uint16_t> sel = path;
-    sel.push_back(n->fid);
-    for (auto fid: sel){
-        std::vector<uint8_t> a = {0x00,0xA4,0x00,0x0C,0x02,(uint8_t)(fid>>8),(uint8_t)(fid&0xFF)};
-        (void)s.transmit(a, 2000);
+    // с SFI файл выбирается самой командой чтения, если его DF уже текущий
+    int sfi = 0;
+    if (n->sfi && !(curDf_==path && curEf_==n->fid)){
+        selectDf(path);
+        if (curDf_==path) sfi = n->sfi;
     }
+    if (!sfi) selectEf(path, n->fid);
     std::vector<uint8_t> data;
     if (n->type==EfType::Transparent){
-        int remaining=n->size, off=0;
-        while (remaining>0){
-            int chunk = std::min(remaining, 0xFF);
-            std::vector<uint8_t> apdu = {0x00,0xB0,(uint8_t)(off>>8),(uint8_t)(off&0xFF),(uint8_t)chunk};
-            auto r = s.transmit(apdu, 2000);
-            data.insert(data.end(), r.begin(), r.end());
-            off += chunk; remaining -= chunk;
-        }
+        data = readTransparent(n->size, sfi);
     } else if (n->type==EfType::LinearFixed){
-        for (int rec=1; rec<=n->recordCount; ++rec){
-            std::vector<uint8_t> apdu = {0x00,0xB2,(uint8_t)rec,0x04,(uint8_t)n->recordSize};
-            auto r = s.transmit(apdu, 2000);
-            if ((int)r.size()<n->recordSize) r.resize(n->recordSize,0x00);
-            data.insert(data.end(), r.begin(), r.begin()+n->recordSize);
-        }
-    } else {
+        data = readRecords(n->recordSize, n->recordCount, sfi);
+    } else if (n->type==EfType::Cyclic){
+        data = readRecords(n->recordSize, n->recordCount, sfi);     // запись 1 — самая свежая
     }
+    if (sfi && curDf_==path) curEf_ = n->fid;
+    ++progress_.ef;
+    reportProgress();
 
     if (!n->saveAs.isEmpty()){
         QString rel = n->saveAs;
@@ -123,38 +422,45 @@ static void traverseRead(Node* n, std::vector<uint16_t>& path, ReaderSession& s,
 
 void Rik2Worker::readAll(const Rik2Layout& L, const QDir& outDir, std::function<void(const QString&)> log){
 
-    (void)getAtr();
+    pathSelect_ = L.pathSelect;
+    begin(L);
+    (void)getAtr(smartio::ResetMode::Reuse);
+    ensureProfile(L, log);
 
     std::vector<uint16_t> path;
     path.push_back(L.root->fid);
     for (auto& ch : L.root->children){
-        traverseRead(ch.get(), path, s_, outDir, log);
+        traverseRead(ch.get(), path, outDir, log);
     }
     log("Считывание всех файлов завершено");
 }
 
 void Rik2Worker::markupCard(const Rik2Layout& L, std::function<void(const QString&)> log){
+    pathSelect_ = L.pathSelect;
     std::function<void(Node*, std::vector<uint16_t>&)> walk = [&](Node* n, std::vector<uint16_t>& path){
         if (n->type==EfType::DF){
-            std::vector<uint16_t> sel = path; sel.push_back(n->fid);
-            selectByPath(sel);
             path.push_back(n->fid);
+            selectDf(path);
             for (auto& ch: n->children) walk(ch.get(), path);
             path.pop_back();
             return;
         }
 
-        selectByPath(path);
+        selectDf(path);
         for (auto& capdu : n->createApdus){
-            (void)s_.transmit(capdu, 5000);
+            (void)transmitInto(capdu.data(), capdu.size(), 5000);
+            curEf_ = -1;    // созданный файл становится текущим
         }
-        selectFid(n->fid);
+        selectEf(path, n->fid);
+        ++progress_.ef;
+        reportProgress();
         log(QString("Подготовлен EF %1 (FID %2)").arg(n->name).arg(n->fid,4,16,QLatin1Char('0')));
     };
 
+    begin(L);
     std::vector<uint16_t> path;
-    selectFid(L.root->fid);
     path.push_back(L.root->fid);
+    selectDf(path);
     for (auto& ch: L.root->children) walk(ch.get(), path);
     log("Разметка: выполнена");
 }
@@ -8,6 +8,7 @@
 #include <QMessageBox>
 #include <QHeaderView>
 #include <QStatusBar>
+#include <chrono>
 #include "Hex.hpp"
 
 static QStandardItem* makeItem(const QString& text){ auto* i=new QStandardItem(text); i->setEditable(false); return i; }
@@ -34,6 +35,7 @@ MainWindow::MainWindow(){
     connect(aMk,&QAction::triggered,this,&MainWindow::onMarkup);
     connect(aOn,&QAction::triggered,this,&MainWindow::onPowerOn);
     connect(aOff,&QAction::triggered,this,&MainWindow::onPowerOff);
+    jobActions_ = {aOpenLib, aConn, aLoad, aRead, aMk, aOn, aOff};
 
     auto* split = new QSplitter;
     tree_ = new QTreeView;
@@ -49,6 +51,7 @@ MainWindow::MainWindow(){
     setCentralWidget(split);
 
     connect(qApp, &QCoreApplication::aboutToQuit, this, [this]{
+        stopJob();
         session_.unload();
         worker_.reset();
     });
@@ -56,6 +59,18 @@ MainWindow::MainWindow(){
     status_ = new QLabel("Ready"); statusBar()->addWidget(status_, 1);
     prog_ = new QProgressBar; prog_->setMinimum(0); prog_->setMaximum(0); prog_->setVisible(false);
     statusBar()->addPermanentWidget(prog_);
+    cancel_ = new QPushButton("Отмена"); cancel_->setVisible(false);
+    statusBar()->addPermanentWidget(cancel_);
+    connect(cancel_,&QPushButton::clicked,this,&MainWindow::onCancel);
+
+    connect(this,&MainWindow::jobProgress,this,&MainWindow::onJobProgress,Qt::QueuedConnection);
+    connect(this,&MainWindow::jobFinished,this,&MainWindow::onJobFinished,Qt::QueuedConnection);
+    logTimer_.setInterval(100);
+    connect(&logTimer_,&QTimer::timeout,this,&MainWindow::flushLog);
+}
+
+MainWindow::~MainWindow(){
+    stopJob();
 }
 
 void MainWindow::onOpenLib(){
@@ -174,27 +189,86 @@ void MainWindow::onReadAll(){
     if (!session_.isOpen() || !layout_){ QMessageBox::warning(this,"Read All","Connect and load layout first."); return; }
     auto dir = QFileDialog::getExistingDirectory(this,"Select output folder",".");
     if (dir.isEmpty()) return;
-    prog_->setVisible(true); log("Начато считывание всех файлов…");
-    try{
-        worker_->readAll(*layout_, QDir(dir), [&](const QString& s){ log(s); });
-        log("Считывание всех файлов завершено.");
-    } catch(const std::exception& ex){
-        QMessageBox::critical(this,"Read All error", ex.what());
-    }
-    prog_->setVisible(false);
+    startJob("Начато считывание всех файлов…", "Считывание всех файлов завершено.", "Read All error",
+             [this, dir](const std::function<void(const QString&)>& log){ worker_->readAll(*layout_, QDir(dir), log); });
 }
 
 void MainWindow::onMarkup(){
     if (!session_.isOpen() || !layout_){ QMessageBox::warning(this,"Markup","Connect and load layout first."); return; }
     if (QMessageBox::question(this,"Разметка","Выполнить разметку карты согласно загруженной разметке?\nЭто может изменить содержимое карты!")!=QMessageBox::Yes) return;
-    prog_->setVisible(true); log("Начата разметка карты…");
-    try{
-        worker_->markupCard(*layout_, [&](const QString& s){ log(s); });
-        log("Разметка карты завершена.");
-    } catch(const std::exception& ex){
-        QMessageBox::critical(this,"Markup error", ex.what());
-    }
-    prog_->setVisible(false);
+    startJob("Начата разметка карты…", "Разметка карты завершена.", "Markup error",
+             [this](const std::function<void(const QString&)>& log){ worker_->markupCard(*layout_, log); });
+}
+
+void MainWindow::startJob(const QString& title, const QString& done, const QString& errTitle,
+                          std::function<void(const std::function<void(const QString&)>&)> job){
+    for (auto* a : jobActions_) a->setEnabled(false);
+    jobDone_ = done; jobErrTitle_ = errTitle;
+    prog_->setMaximum(0); prog_->setValue(0); prog_->setVisible(true);
+    cancel_->setEnabled(true); cancel_->setVisible(true);
+    log(title);
+    logTimer_.start();
+    jobTime_.start();
+
+    // не чаще 20 раз в секунду, последний EF — всегда
+    worker_->requestCancel(false);
+    worker_->setProgressCallback([this, last = std::chrono::steady_clock::time_point{}](const Rik2Progress& p) mutable {
+        const auto now = std::chrono::steady_clock::now();
+        if (p.ef < p.efTotal && now - last < std::chrono::milliseconds(50)) return;
+        last = now;
+        emit jobProgress(p.ef, p.efTotal, p.bytes, p.apdus);
+    });
+    job_ = std::thread([this, job = std::move(job)]{
+        QString err; bool cancelled = false;
+        try { job([this](const QString& s){ postLog(s); }); }
+        catch (const Rik2Cancelled&) { cancelled = true; }
+        catch (const std::exception& ex) { err = QString::fromUtf8(ex.what()); }
+        catch (...) { err = "Неизвестная ошибка"; }
+        emit jobFinished(err, cancelled);
+    });
+}
+
+void MainWindow::stopJob(){
+    if (!job_.joinable()) return;
+    worker_->requestCancel();
+    job_.join();
+}
+
+void MainWindow::onCancel(){
+    if (!worker_) return;
+    worker_->requestCancel();
+    cancel_->setEnabled(false);
+    status_->setText("Отмена после текущего APDU…");
+}
+
+void MainWindow::onJobProgress(int ef, int efTotal, quint64 bytes, quint64 apdus){
+    const double s = jobTime_.elapsed() / 1000.0;
+    prog_->setMaximum(efTotal); prog_->setValue(ef);
+    status_->setText(QString("EF %1 из %2, %3 КБ, %4 APDU/с").arg(ef).arg(efTotal)
+                     .arg(bytes / 1024.0, 0, 'f', 1).arg(s > 0 ? apdus / s : 0, 0, 'f', 0));
+}
+
+void MainWindow::onJobFinished(QString error, bool cancelled){
+    if (job_.joinable()) job_.join();
+    worker_->setProgressCallback(nullptr);
+    logTimer_.stop();
+    flushLog();
+    prog_->setVisible(false); cancel_->setVisible(false);
+    for (auto* a : jobActions_) a->setEnabled(true);
+    if (cancelled) { log("Операция отменена."); status_->setText("Отменено"); }
+    else if (!error.isEmpty()) QMessageBox::critical(this, jobErrTitle_, error);
+    else log(jobDone_);
+}
+
+void MainWindow::postLog(const QString& s){
+    std::lock_guard<std::mutex> lk(logMutex_);
+    pendingLog_ << s;
+}
+
+void MainWindow::flushLog(){
+    QStringList lines;
+    { std::lock_guard<std::mutex> lk(logMutex_); lines.swap(pendingLog_); }
+    if (!lines.isEmpty()) log_->append(lines.join('\n'));
 }
 
 void MainWindow::onPowerOn(){
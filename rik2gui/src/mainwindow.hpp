@@ -6,6 +6,12 @@
 #include <QProgressBar>
 #include <QLabel>
 #include <QSplitter>
+#include <QPushButton>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include "ReaderSession.hpp"
 #include "Rik2Model.hpp"
 #include "Rik2Worker.hpp"
@@ -14,6 +20,12 @@ class MainWindow : public QMainWindow {
     Q_OBJECT
 public:
     MainWindow();
+    ~MainWindow() override;
+
+signals:
+    // Из потока операции; доставляются в GUI-поток очередью.
+    void jobProgress(int ef, int efTotal, quint64 bytes, quint64 apdus);
+    void jobFinished(QString error, bool cancelled);
 
 private slots:
     void onOpenLib();
@@ -23,10 +35,19 @@ private slots:
     void onMarkup();
     void onPowerOn();
     void onPowerOff();
+    void onCancel();
+    void onJobProgress(int ef, int efTotal, quint64 bytes, quint64 apdus);
+    void onJobFinished(QString error, bool cancelled);
+    void flushLog();
 
 private:
     void rebuildTree();
     void log(const QString& s);
+    // Read All / Markup: job выполняется в job_, журнал — через postLog пачками.
+    void startJob(const QString& title, const QString& done, const QString& errTitle,
+                  std::function<void(const std::function<void(const QString&)>&)> job);
+    void postLog(const QString& s);
+    void stopJob();
 
     ReaderSession session_;
     std::optional<Rik2Layout> layout_;
@@ -37,5 +58,14 @@ private:
     QTextEdit* log_;
     QLabel* status_;
     QProgressBar* prog_;
+    QPushButton* cancel_;
+    QList<QAction*> jobActions_;     // недоступны, пока идёт операция
+
+    std::thread job_;
+    QString jobDone_, jobErrTitle_;
+    QElapsedTimer jobTime_;
+    std::mutex logMutex_;
+    QStringList pendingLog_;
+    QTimer logTimer_;
     QString libPath_ = "acr38usb";
 };